@@ -2,696 +2,1057 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdarg.h>
 
-#define BLU "\x1B[34m"
-#define GRN "\x1B[32m"
-#define YEL "\x1B[33m"
-#define PUR "\x1B[35m"
-#define RED "\x1B[31m"
-#define END "\x1B[0m"
+#include "allocator.h"
 
-#define MAX 1048576 /* The maximum number of bytes in virtual memory */
-#define MAX_LINE 80 /* The maximum length command */
+__thread long bytes = 0; /* The total number of bytes requested by the user */
 
-int bytes = 0; /* The total number of bytes requested by the user */
-int allocated = 0; /* The total number of bytes in use by processes */
-
-bool shouldrun = true; /* boolean to determine when the user quits */
 bool debug = false; /* boolean to determine whether or not to print info */
+bool batch = false; /* boolean to determine if replaying a trace without prompts */
 
-typedef struct process {
-    char *name; /* name of the process (i.e. P0) */
-    int size; /* size to allocate in bytes */
-    int start; /* start address in virtual memory */
-    int end; /* end address in virtual memory */
-} process;
+__thread bool quiet = false; /* silences per-process messages while a batch command runs */
+__thread bool relocating = false; /* set while a resize moves a process, which is
+                                     neither a request nor a release */
+__thread struct summary totals = { 0 }; /* what the calling thread did during this run */
 
-typedef struct name {
-    struct name *next; /* pointer to the next name in the list */
-    struct name *prev; /* pointer to the previous name in the list */
-    int processNum; /* the process' number (i.e. 10 given P10) */
-} name;
+bool compactOnFailure = false; /* compact just enough to satisfy a failed request */
+double compactAbove = 0; /* compact an arena once a release leaves its external
+                            fragmentation above this fraction, 0 if never */
+long compactEvery = 0; /* compact an arena after this many releases, 0 if never */
 
-typedef struct node {
-    struct node *next; /* pointer to the next node in the list */
-    struct node *prev; /* pointer to the previous node in the list */
-    struct process *process; /* pointer to the process belonging to the node */
-    bool hole; /* flag to determine if node's process is a hole */
-} node;
+enum engine mode = LIST; /* which engine manages memory, chosen at startup */
 
-struct node *head = NULL; /* head of the doubly linked list of processes */
-struct node *tail = NULL; /* tail of the doubly linked list of processes */
-struct name *namehead = NULL; /* head of the doubly linked list of names */
+void report(const char *format, ...) {
 
-node *temptail = NULL;
-node *temphead = NULL;
+    if (batch || quiet) {
+        return;
+    }
 
-/* creates and returns a process, initializing name and size */
-struct process * createProcess(char *name, int size); 
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
 
-/* releases a process from memory, if present, creating a hole */
-int releaseProcess(char *name);
+void printSegment(struct node *n /* NULL while the arena is empty */) {
 
-/* creates a hole in memory and merges said hole with surrounding holes */
-int makeProcessHole(char *name);
+    /* trace output is meant for files and diffs, so leave out colors */
+    const char *red = batch ? "" : RED;
+    const char *blu = batch ? "" : BLU;
+    const char *end = batch ? "" : END;
 
-/* creates a node given a process & start & end addresses */
-void createNode(struct process *p, int start, int end);
+    /* arenas count addresses from their own base */
+    long base = current->base;
 
-/* prints the doubly linked list */
-void printLinkedList();
+    if (!n) {
+        printf("Addresses [%ld:%ld] %sUnused\n%s", base, base + current->bytes - 1, red, end);
+    } else if (n->hole) {
+        printf("Addresses [%ld:%ld] %sUnused\n%s", base + n->start, base + n->end, red, end);
+    } else if (mode == BUDDY) {
+        printf("Addresses [%ld:%ld] %sProcess %s (%ld bytes)\n%s", base + n->start, base + n->end, blu, n->name, n->size, end);
+    } else {
+        printf("Addresses [%ld:%ld] %sProcess %s\n%s", base + n->start, base + n->end, blu, n->name, end);
+    }
+}
 
-/* frees the doubly linked list from memory */
-void freeLinkedList();
+void stat() {
 
-/* locates and returns a process in the doubly linked list- 
-   returns null if process is not in the list */
-struct node *locateProcess(char *name);
+    long lost = 0;
+    long reserved = 0;
 
-/* allocates a process in memory according to Worst Fit, Best Fit,
-   or First Fit algorithm (indicated by the flag) only if there is
-   a hole large enough for the requested allocation size */
-int allocateProcess(char *command, char flag);
+    node *n;
+    printf("\n");
+    int i;
+    for (i = 0; i < arenaCount; i++) {
+        lockArena(&arenas[i]);
+        current = &arenas[i];
+        if (mode == TABLE) {
+            printTable(0, current->bytes - 1);
+        } else if (current->head) {
+            for (n = current->tail; n != NULL; n = n->prev) {
+                printSegment(n);
+            }
+        } else {
+            printSegment(NULL);
+        }
+        lost += internalFragmentation();
+        reserved += current->buddies.reserved;
+        unlockArena(&arenas[i]);
+    }
+    printf("\n");
 
-/* searches list of process names for duplicates and returns
-   true if duplicate found, false if not */
-bool duplicate();
+    if (mode == BUDDY) {
+        printf("Internal fragmentation: %ld of %ld reserved bytes\n\n", lost, reserved);
+    }
+}
 
-/* negates a processes' name if a memory size is caught, so
-   the user can reuse the unsuccessful process' name again */
-void negateProcess(char *name);
+struct node *segmentAt(long address) {
 
-/* combines two adjacent holes into one node */
-void combineHoles(struct node *b, struct node *a);
+    if (mode == TLSF) {
+        /* this engine keeps no address index, so walk up from address 0 */
+        struct node *n = current->tail;
+        while (n && n->end < address) {
+            n = n->prev;
+        }
+        return n;
+    }
 
-/* combines three adjacent holes into one node */
-void combineThreeHoles(struct node *a, struct node *b, struct node *c);
+    /* the last segment starting at or below the address */
+    struct node probe = { .start = address + 1 };
+    struct avlnode *found = avlLowerBound(&current->segments, &probe.byaddr);
+    found = found ? avlPrev(found) : avlLast(&current->segments);
+    return found ? containerOf(found, node, byaddr) : NULL;
+}
 
-/* creates and returns a hole node */
-struct node * createHole(struct process *p, int start, int end);
+int lookupAddress(struct command *c) {
 
-/* allocates a process into a hole that was previously a process */
-void allocateProcessIntoHole(struct node *holeNode, struct process *processNode);
+    long address;
+    if (c->count != 2 || !parseNumber(c->words[1], &address)) {
+        report(RED "\nTo find the segment holding an address, structure a command as follows:\n" END);
+        report("\nAT [address]\n\n");
+        return -1;
+    }
 
-/* print the fields of a given node */
-void printNode(node *n);
+    if (address < 0 || address >= bytes) {
+        report(RED "\nAddress %ld is outside of memory (0 to %ld).\n\n" END, address, bytes - 1);
+        return -1;
+    }
 
-/* print the names of processes previously allocated */
-void printNames();
+    struct arena *a = arenaOf(address);
+    lockArena(a);
+    current = a;
+    printf("\n");
+    if (mode == TABLE) {
+        printTable(address - a->base, address - a->base);
+    } else {
+        printSegment(segmentAt(address - a->base));
+    }
+    printf("\n");
+    unlockArena(a);
+    return 0;
+}
 
-/* free the doubly linked list holding names of processes */
-void freeNames();
+int lookupRange(struct command *c) {
 
-/* add a name to the doubly linked list holding names of processes */
-void addName(char *n);
+    long first, last;
+    if (c->count != 3 || !parseNumber(c->words[1], &first) || !parseNumber(c->words[2], &last)) {
+        report(RED "\nTo list the segments in a range of addresses, structure a command as follows:\n" END);
+        report("\nRANGE [first address] [last address]\n\n");
+        return -1;
+    }
 
-/* allocates a given process into the largest hole in memory */
-void worstFit(struct process *p);
+    if (first < 0 || last >= bytes || first > last) {
+        report(RED "\nPlease enter a range of addresses from 0 to %ld, lowest first.\n\n" END, bytes - 1);
+        return -1;
+    }
 
-/* allocates a given process into the smallest hole in memory
-   that is large enough for said process */
-void bestFit(struct process *p);
+    printf("\n");
+    struct arena *a;
+    for (a = arenaOf(first); a < arenas + arenaCount && a->base <= last; a++) {
+        lockArena(a);
+        current = a;
+
+        if (mode == TABLE) {
+            printTable(first > a->base ? first - a->base : 0, last - a->base);
+            unlockArena(a);
+            continue;
+        }
 
-/* allocate a given process into the first hole in memory that is
-   large enough (first meaning starting from address 0) */
-void firstFit(struct process *p);
+        /* one lookup, then the list itself is in address order */
+        struct node *n = segmentAt(first > a->base ? first - a->base : 0);
+        if (!n) {
+            printSegment(NULL);
+        }
+        for (; n && n->start <= last - a->base; n = n->prev) {
+            printSegment(n);
+        }
+        unlockArena(a);
+    }
+    printf("\n");
+    return 0;
+}
 
-/* reports the status of memory */
-void stat();
+long slideProcesses(struct node *first, struct node *last) {
 
-/* compacts all holes into one hole and places all processes
-   adjacent to each other */
-void compact();
+    struct node *below = first->next; /* untouched node under the range */
+    struct node *above = last->prev; /* untouched node over the range */
+    struct node *kept = below; /* highest process relinked so far */
+    long cursor = first->start; /* where the next process belongs */
+    long freeBytes = 0;
+    long moved = 0;
+    bool roverRemoved = false;
 
-/* printing for error handling */
-void printRequestError();
-void printReleaseError(int howMany);
-void noMemoryLeft(char *name);
+    struct node *n = first;
+    while (n != above) {
+        struct node *up = n->prev;
 
-int main(int argc, char *argv[]) {
+        if (n->hole) {
+            freeBytes += n->size;
+            unindexHole(n);
+            unindexSegment(n);
+            unbindName(n);
+            if (n == current->rover) {
+                roverRemoved = true;
+            }
+            putNode(n);
+        } else {
+            if (n->start != cursor) {
+                long from = n->start;
+                moved += n->size;
+                if (tracing) {
+                    recordEvent(HAPPENED_MOVE, cursor, n->size, from);
+                }
+                n->start = cursor;
+                n->end = cursor + n->size - 1;
 
-    if (argc != 2) {
-        printf(RED "\nPlease enter a positive number of bytes to be allocated.\n\n" END);
-        return -1;
-    }
+                /* every process below has already moved down, so its
+                   bytes are out of the way */
+                if (current->data) {
+                    moveData(n, from);
+                }
+            }
+            cursor += n->size;
 
-    bytes = atoi(argv[1]);
+            n->next = kept;
+            if (kept) {
+                kept->prev = n;
+            } else {
+                current->tail = n;
+            }
+            kept = n;
+        }
 
-    if (bytes <= 0) {
-        printf(RED "\nPlease enter a positive number of bytes to be allocated.\n\n" END);
-        return -1;
-    } else if (bytes > MAX) {
-        printf(RED "\nPlease enter a positive number of bytes less than or equal to %d.\n\n" END, MAX);
-        return -1;
+        n = up;
     }
 
     if (debug) {
-        printf("\nMaximum number of bytes: %d\n\n", bytes);
+        printf("Free bytes: %ld\n", freeBytes);
+        printf("Hole start: %ld\n", cursor);
+        printf("Hole end: %ld\n", cursor + freeBytes - 1);
     }
 
-    while (shouldrun) {
-        printf(BLU "allocator" END "$ ");
-        fflush(stdout);
+    /* the free bytes of the range become one hole on top of it, merged
+       with the hole above if there is one */
+    struct node *top = kept;
+    if (freeBytes > 0) {
+        if (above && above->hole) {
+            unindexHole(above);
+            above->start = cursor;
+            above->size += freeBytes;
+            indexHole(above);
+            top = above;
+        } else {
+            top = createHole(cursor, cursor + freeBytes - 1);
+            indexHole(top);
+            indexSegment(top);
+            top->next = kept;
+            if (kept) {
+                kept->prev = top;
+            } else {
+                current->tail = top;
+            }
+        }
+    }
 
-        char command[MAX_LINE];
-        fgets(command, MAX_LINE, stdin);
+    /* next fit carries on from the hole that replaced its position */
+    if (roverRemoved) {
+        current->rover = top;
+    }
 
-        if (strcmp(command, "X\n") == 0 || strcmp(command, "q\n") == 0) {
-            shouldrun = 0; /* exit */
-            
-        } else if (command[strlen(command) - 2] == 'F') {
-            allocateProcess(command, 'F'); /* First fit */
+    if (top != above) {
+        top->prev = above;
+        if (above) {
+            above->next = top;
+        } else {
+            current->head = top;
+        }
+    } else {
+        above->next = kept;
+        if (kept) {
+            kept->prev = above;
+        } else {
+            current->tail = above;
+        }
+    }
 
-        } else if (command[strlen(command) - 2] == 'B') {
-            allocateProcess(command, 'B'); /* Best fit */
+    return moved;
+}
 
-        } else if (command[strlen(command) - 2] == 'W') {
-            allocateProcess(command, 'W'); /* Worst fit */
+void compact() {
 
-        } else if (strcmp(command, "C\n") == 0) {
-            compact();
+    report("\nCompacting all free memory together... ");
+    totals.compactions++;
 
-        } else if (strcmp(command, "STAT\n") == 0) {
-            stat();
+    long moved = 0;
+    int i;
+    for (i = 0; i < arenaCount; i++) {
+        lockArena(&arenas[i]);
+        current = &arenas[i];
+        moved += compactArena();
+        unlockArena(&arenas[i]);
+    }
+    totals.moved += moved;
 
-        } else {
-            releaseProcess(command);
+    report(GRN "compacted, %ld bytes moved.\n\n" END, moved);
+}
 
-        }
+long compactArena() {
+
+    if (mode == BUDDY) {
+        return buddyCompact();
+    } else if (mode == TABLE) {
+        return tableCompact();
     }
 
-    freeNames();
-    freeLinkedList();
+    /* processes below the lowest hole are already in place */
+    struct node *first = current->tail;
+    while (first && !first->hole) {
+        first = first->prev;
+    }
 
+    if (first && first != current->head) {
+        return slideProcesses(first, current->head);
+    }
     return 0;
 }
 
-void stat() {
+void compactAfterRelease() {
 
-    node *n;
-    if (head) {
-        printf("\n");
-        for (n = tail; n != NULL; n = n->prev) {
-            if (n->hole) {
-                printf("Addresses [%d:%d] " RED "Unused\n" END, n->process->start, n->process->end);
-            } else {
-                printf("Addresses [%d:%d] " BLU "Process %s\n" END, n->process->start, n->process->end, n->process->name);
-            }
+    current->releases++;
+
+    enum trigger t;
+    if (compactEvery && current->releases >= compactEvery) {
+        t = ON_RELEASES;
+    } else if (compactAbove > 0) {
+        struct metrics m = { 0 };
+        arenaMetrics(&m);
+        if (externalFragmentation(&m) <= compactAbove) {
+            return;
         }
-        printf("\n");
+        t = ON_FRAGMENTATION;
     } else {
-        printf("\nAddresses [%d:%d] " RED "Unused\n\n" END, 0, bytes - 1);
+        return;
     }
-}
 
-void compactProcess(struct process *p, bool isHole) {
+    /* a later request larger than any hole there was before is one
+       this compaction rescued */
+    current->compactedFrom = largestHole();
+    current->compactedBy = t;
+    current->releases = 0;
+
+    long moved = compactArena();
+    totals.compactions++;
+    totals.moved += moved;
+    totals.triggered[t]++;
+    totals.triggeredMoved[t] += moved;
+}
 
-    struct node *new = (struct node *) malloc(sizeof(struct node));
-    struct process *newprocess = createProcess(p->name, p->size);
-    new->process = newprocess;
+void printPolicies(struct summary *s) {
 
-    if (isHole) {
-        new->hole = true;
-    } else {
-        new->hole = false;
+    if (compactOnFailure) {
+        printf("Compaction on failure: %ld (%ld bytes moved), %ld requests rescued\n",
+               s->triggered[ON_FAILURE], s->triggeredMoved[ON_FAILURE], s->rescued[ON_FAILURE]);
+    }
+    if (compactAbove > 0) {
+        printf("Compaction above %.1f%% fragmentation: %ld (%ld bytes moved), %ld requests rescued\n",
+               100 * compactAbove, s->triggered[ON_FRAGMENTATION], s->triggeredMoved[ON_FRAGMENTATION],
+               s->rescued[ON_FRAGMENTATION]);
+    }
+    if (compactEvery) {
+        printf("Compaction every %ld releases: %ld (%ld bytes moved), %ld requests rescued\n",
+               compactEvery, s->triggered[ON_RELEASES], s->triggeredMoved[ON_RELEASES], s->rescued[ON_RELEASES]);
     }
-
-    new->process->start = temphead->process->end + 1;
-    new->process->end = new->process->size + new->process->start - 1;
-
-    new->next = temphead;
-    new->prev = NULL;
-
-    temphead->prev = new;
-    temphead = new;
 }
 
-void compact() {
-
-    printf("\nCompacting all free memory together... ");
+long compactUntil(long size) {
 
-    int freeBytes = 0;
+    if (current->bytes - current->allocated < size) {
+        return -1;
+    }
 
-    temptail = NULL;
-    temphead = NULL;
+    report("\nCompacting until a hole of %ld bytes exists... ", size);
+    totals.compactions++;
+
+    /* buddy blocks only line up again once everything is repacked */
+    if (mode == BUDDY) {
+        long moved = buddyCompact();
+        totals.moved += moved;
+        report(GRN "compacted, %ld bytes moved.\n\n" END, moved);
+        return moved;
+    } else if (mode == TABLE) {
+        long moved = tableCompactUntil(size);
+        totals.moved += moved;
+        report(GRN "compacted, %ld bytes moved.\n\n" END, moved);
+        return moved;
+    }
 
-    node *n;
-    for (n = tail; n != NULL; n = n->prev) {
-        if (n->hole) {
-            freeBytes += n->process->size;
+    /* two pointers over the list: for each top segment j, move the
+       bottom segment i up for as long as [i, j] still holds enough free
+       bytes, and remember the window holding the fewest process bytes */
+    struct node *i = current->tail;
+    struct node *j;
+    struct node *bestFirst = NULL;
+    struct node *bestLast = NULL;
+    long freeBytes = 0;
+    long used = 0;
+    long bestUsed = 0;
+
+    for (j = current->tail; j != NULL; j = j->prev) {
+        if (j->hole) {
+            freeBytes += j->size;
         } else {
-            if (!temptail) {
-
-                struct node *new = (struct node *) malloc(sizeof(struct node));
-                struct process *newprocess = createProcess(n->process->name, n->process->size);
-                new->process = newprocess;
-                new->hole = false;
-
-                temptail = new;
-                temphead = new;
-                new->next = NULL;
-                new->prev = NULL;
-                new->process->start = 0;
-                new->process->end = n->process->size - 1;
-                new->process->size = n->process->size;
-                new->process->name = n->process->name;
+            used += j->size;
+        }
 
+        while (i != j && freeBytes - (i->hole ? i->size : 0) >= size) {
+            if (i->hole) {
+                freeBytes -= i->size;
             } else {
-                compactProcess(n->process, false);
+                used -= i->size;
             }
+            i = i->prev;
+        }
+
+        if (freeBytes >= size && (!bestFirst || used < bestUsed)) {
+            bestFirst = i;
+            bestLast = j;
+            bestUsed = used;
         }
     }
 
-    freeLinkedList();
+    long moved = 0;
+    if (bestFirst && bestFirst != bestLast) {
+        moved = slideProcesses(bestFirst, bestLast);
+    }
+    totals.moved += moved;
 
-    if (freeBytes > 0) {
-        struct process *hole = createProcess("hole", freeBytes);
-        if (debug) {
-            printf("Free bytes: %d\n", freeBytes);
-            printf("Hole start: %d\n", temphead->process->end + 1);
-            printf("Hole end: %d\n", bytes - 1);
+    report(GRN "compacted, %ld bytes moved.\n\n" END, moved);
+    return moved;
+}
+
+int allocateIntoEmptyMemory(struct node *p) {
+
+    if (p->size < current->bytes) {
+        createNode(p, 0, p->size - 1);
+        if (tracing) {
+            recordEvent(HAPPENED_SPLIT, 0, p->size, current->bytes - p->size);
         }
-        struct node *h = createHole(hole, temphead->process->end + 1, bytes - 1);
-        compactProcess(h->process, true);
-        head = temphead;
-        tail = temptail;
+        struct node *h = createHole(p->size, current->bytes - 1);
+        h->next = p;
+        p->prev = h;
+        current->head = h;
+        indexHole(h);
+        indexSegment(h);
+    } else if (p->size == current->bytes) {
+        createNode(p, 0, p->size - 1);
+    } else {
+        return -1;
     }
 
-   printf(GRN "compacted.\n\n" END);
+    return 0;
+}
+
+void processCreated(struct node *p) {
 
+    current->allocated += p->size;
+    if (current->data) {
+        fillData(p);
+    }
+    if (relocating) {
+        return;
+    }
+    totals.placed++;
+    if (tracing) {
+        recordEvent(HAPPENED_REQUEST, p->start, p->size, 0);
+    }
+    report(GRN "\nProcess %s created with %ld bytes allocated.\n\n" END, p->name, p->size);
+
+    if (debug) {
+        printf(PUR "%ld bytes allocated so far.\n\n" END, current->allocated);
+    }
 }
 
-void worstFit(struct process *p /* a process with only a name and size */) {
+int worstFit(struct node *p /* a process with only a name and size */) {
 
-    if (!head) {
-        if (p->size < bytes) {
-            createNode(p, 0, p->size - 1);
-            struct process *hole = createProcess("hole", bytes - p->size);
-            struct node *h = createHole(hole, p->size, bytes - 1);
-            struct node *prc = locateProcess(p->name);
-            h->next = prc;
-            prc->prev = h;
-            head = h;
-        } else if (p->size == bytes) {
-            createNode(p, 0, p->size - 1);
-        } else {
-            noMemoryLeft(p->name);
-            negateProcess(p->name);
-            return;
+    if (!current->head) {
+        if (allocateIntoEmptyMemory(p) < 0) {
+            return -1;
         }
     } else {
 
-        /* find the largest hole that is big enough and allocate */
-        node *n;
+        /* find the largest hole (lowest address among equals) and
+           allocate if it is big enough */
         node *largest = NULL;
-        for (n = tail; n != NULL; n = n->prev) {
-            if (n->hole) {
-                if (n->process->size >= p->size) {
-                    if (largest) {
-                        if (n->process->size > largest->process->size) {
-                            largest = n;
-                        }
-                    } else {
-                        largest = n;
-                    }
-                }
-            }
+        struct avlnode *last = avlLast(&current->holes);
+        if (last) {
+            largest = smallestHoleOfSize(containerOf(last, node, bysize)->size);
         }
 
-        if (largest) {
+        if (largest && largest->size >= p->size) {
             allocateProcessIntoHole(largest, p);
         } else {
-            noMemoryLeft(p->name);
-            negateProcess(p->name);
-            return;
+            return -1;
         }
     }
     
-    allocated += p->size;
-    printf(GRN "\nProcess %s created with %d bytes allocated.\n\n" END, p->name, p->size);
-
-    if (debug) {
-        printf(PUR "%d bytes allocated so far.\n\n" END, allocated);
-    }
+    processCreated(p);
+    return 0;
 }
 
-void bestFit(struct process *p /* a process with only a name and size */) {
+int bestFit(struct node *p /* a process with only a name and size */) {
 
-    if (!head) {
-        if (p->size < bytes) {
-            createNode(p, 0, p->size - 1);
-            struct process *hole = createProcess("hole", bytes - p->size);
-            struct node *h = createHole(hole, p->size, bytes - 1);
-            struct node *prc = locateProcess(p->name);
-            h->next = prc;
-            prc->prev = h;
-            head = h;
-        } else if (p->size == bytes) {
-            createNode(p, 0, p->size - 1);
-        } else {
-            noMemoryLeft(p->name);
-            negateProcess(p->name);
-            return;
+    if (!current->head) {
+        if (allocateIntoEmptyMemory(p) < 0) {
+            return -1;
         }
     } else {
         
         /* find the smallest hole that is big enough and allocate */
-        node *n;
-        node *smallest = NULL;
-        for (n = tail; n != NULL; n = n->prev) {
-            if (n->hole) {
-                if (n->process->size >= p->size) {
-                    if (smallest) {
-                        if (n->process->size < smallest->process->size) {
-                            smallest = n;
-                        }
-                    } else {
-                        smallest = n;
-                    }
-                }
-            }
-        }
+        node *smallest = smallestHoleOfSize(p->size);
 
         if (smallest) {
             allocateProcessIntoHole(smallest, p);
         } else {
-            noMemoryLeft(p->name);
-            negateProcess(p->name);
-            return;
+            return -1;
         }
     }
     
-    allocated += p->size;
-    printf(GRN "\nProcess %s created with %d bytes allocated.\n\n" END, p->name, p->size);
-
-    if (debug) {
-        printf(PUR "%d bytes allocated so far.\n\n" END, allocated);
-    }
+    processCreated(p);
+    return 0;
 }
 
-void firstFit(struct process *p /* a process with only a name and size */) {
+int firstFit(struct node *p /* a process with only a name and size */) {
     
-    if (!head) {
-        if (p->size < bytes) {
-            createNode(p, 0, p->size - 1);
-            struct process *hole = createProcess("hole", bytes - p->size);
-            struct node *h = createHole(hole, p->size, bytes - 1);
-            struct node *prc = locateProcess(p->name);
-            h->next = prc;
-            prc->prev = h;
-            head = h;
-        } else if (p->size == bytes) {
-            createNode(p, 0, p->size - 1);
-        } else {
-            noMemoryLeft(p->name);
-            negateProcess(p->name);
-            return;
+    if (!current->head) {
+        if (allocateIntoEmptyMemory(p) < 0) {
+            return -1;
         }
     } else {
         node *n;
-        for (n = tail; n != NULL; n = n->prev) {
+        for (n = current->tail; n != NULL; n = n->prev) {
 
             /* if we reach the head, we've run out of holes prior to 
                the highest allocated process in memory */
             
-            if (n == head) {
+            if (n == current->head) {
                 if (n->hole) {
-                    if (n->process->size >= p->size) {
+                    if (n->size >= p->size) {
                         allocateProcessIntoHole(n, p);
                         break;
                     }
                 } else {
-                    noMemoryLeft(p->name);
-                    negateProcess(p->name);
-                    return;
+                    return -1;
                 }
             } else {
                 if (n->hole) {
-                    if (n->process->size >= p->size) {
+                    if (n->size >= p->size) {
                         allocateProcessIntoHole(n, p);
                         break;
                     }
                 }
             }
         }
-    }
 
-    allocated += p->size;
-    printf(GRN "\nProcess %s created with %d bytes allocated.\n\n" END, p->name, p->size);
-
-    if (debug) {
-        printf(PUR "%d bytes allocated so far.\n\n" END, allocated);
+        /* the head was a hole, but too small */
+        if (!n) {
+            return -1;
+        }
     }
+
+    processCreated(p);
+    return 0;
 }
 
-int allocateProcess(char *command, char flag) {
+int nextFit(struct node *p /* a process with only a name and size */) {
+
+    if (!current->head) {
+        if (allocateIntoEmptyMemory(p) < 0) {
+            return -1;
+        }
+    } else {
 
-    char **parsed = malloc(sizeof(char *) * 4);
-    char *space = strtok(command, " ");
+        /* resume where the last process was placed and wrap around
+           from the head back to address 0 */
+        node *start = current->rover ? current->rover : current->tail;
+        node *n = start;
+        bool placed = false;
+
+        do {
+            if (n->hole && n->size >= p->size) {
+                allocateProcessIntoHole(n, p);
+                placed = true;
+                break;
+            }
+            n = n->prev ? n->prev : current->tail;
+        } while (n != start);
 
-    int i = 0;
-    while (space) {
-        if (i > 3) {
-            printRequestError();
+        if (!placed) {
             return -1;
         }
-        parsed[i] = space;
-        i++;
-        space = strtok(NULL, " ");
     }
 
-    if (strcmp(parsed[0], "RQ") != 0) {
-        printf(RED "\nPlease request allocation using the \"RQ\" command.\n\n" END);
+    current->rover = p;
+    processCreated(p);
+    return 0;
+}
+
+int allocateProcess(struct command *c) {
+
+    if (c->count > 4) {
+        printRequestError();
         return -1;
-    } else if (atoi(parsed[2]) <= 0) {
-        printf(RED "\nPlease enter a valid positive number of bytes.\n\n" END);
+    } else if (c->count < 4) {
+        printReleaseError(-1);
         return -1;
     }
 
-    struct process *p;
-    p = (struct process *) malloc(sizeof(struct process));
-
-    bool dup = duplicate(parsed[1]);
+    long size;
+    if (!parseNumber(c->words[2], &size) || size <= 0) {
+        report(RED "\nPlease enter a valid positive number of bytes.\n\n" END);
+        return -1;
+    }
 
-    if (dup) {
-        printf(RED "\nThe process name %s has already been used.\n", parsed[1]);
-        printf("Please choose a different name.\n\n" END);
+    char flag;
+    if (!parseStrategy(c->words[3], &flag)) {
+        report(RED "\nPlease choose a strategy: F, B, W, N or T.\n\n" END);
         return -1;
     }
 
-    addName(parsed[1]);
+    /* timed from here, so that lines rejected above stay out of the
+       histograms */
+    long begin = latencyClock();
+    int result = requestProcess(c->words[1], size, flag);
+    recordLatency(timedRequest(flag), latencyClock() - begin);
 
-    if (debug) {
-        printNames();
+    return result < 0 ? -1 : 0;
+}
+
+int requestProcess(char *name, long size, char flag) {
+
+    /* a name is only ever handled by one worker at a time (the worker it
+       hashes to, or the first one running a batch while the others wait),
+       so no other thread can take it between this check and placing the
+       process */
+    bool dup = false;
+    int i;
+    for (i = 0; i < arenaCount && !dup; i++) {
+        lockArena(&arenas[i]);
+        current = &arenas[i];
+        dup = duplicate(name);
+        unlockArena(&arenas[i]);
     }
-    
-    p->name = (char *) malloc(sizeof(char *));
-    strcpy(p->name, parsed[1]);
 
-    p->size = atoi(parsed[2]);
-    p->start = -1; /* temporary */
-    p->end = -1; /* temporary */
+    if (dup) {
+        report(RED "\nThe process name %s has already been used.\n", name);
+        report("Please choose a different name.\n\n" END);
+        return -1;
+    }
 
     if (flag == 'W') {
-        printf("\nUsing " RED "Worst Fit" END " Memory Allocation...\n");
-        worstFit(p);
-
+        report("\nUsing " RED "Worst Fit" END " Memory Allocation...\n");
     } else if (flag == 'B') {
-        printf("\nUsing " GRN "Best Fit" END " Memory Allocation...\n");
-        bestFit(p);
-
+        report("\nUsing " GRN "Best Fit" END " Memory Allocation...\n");
     } else if (flag == 'F') {
-        printf("\nUsing " YEL "First Fit" END " Memory Allocation...\n");
-        firstFit(p);
+        report("\nUsing " YEL "First Fit" END " Memory Allocation...\n");
+    } else if (flag == 'N') {
+        report("\nUsing " PUR "Next Fit" END " Memory Allocation...\n");
+    } else if (flag == 'T') {
+        report("\nUsing " BLU "Two-Level Segregated Fit" END " Memory Allocation...\n");
+    }
+    if (mode == BUDDY) {
+        report("Blocks come from the " BLU "Buddy System" END ", the strategy is ignored.\n");
+    } else if (mode == TLSF && flag != 'T') {
+        report("Holes are only indexed for " BLU "Two-Level Segregated Fit" END ", the strategy is ignored.\n");
+    } else if (mode == TABLE && flag == 'T') {
+        report("The table keeps no size classes, so " GRN "Best Fit" END " is used instead.\n");
     }
 
-    return 0;
+    /* start at the home arena and fall back to the others in turn */
+    int home = homeArena(name);
+    for (i = 0; i < arenaCount; i++) {
+        struct arena *a = &arenas[(home + i) % arenaCount];
+        lockArena(a);
+        current = a;
+        int result = requestInArena(name, size, flag);
+        unlockArena(a);
+
+        if (result == 0) {
+            return 0;
+        }
+    }
+
+    noMemoryLeft(name);
+    return 1;
 }
 
-int releaseProcess(char *command) {
+int requestInArena(char *name, long size, char flag) {
 
-    char **parsed = malloc(sizeof(char *) * 4);
-    char *space = strtok(command, " ");
+    struct node *p = createProcess(addName(name), size);
+    p->strategy = flag;
 
-    int i = 0;
-    while (space) {
-        if (i > 1) {
-            printReleaseError(1);
-            return -1;
+    if (debug) {
+        printNames();
+    }
+
+    int result = placeProcess(p, flag);
+
+    /* enough bytes are free, just not in one place. Buddy blocks count
+       whole, since rounding up leaves the tail of a block unusable */
+    long freeBytes = mode == BUDDY ? current->bytes - current->buddies.reserved : current->bytes - current->allocated;
+    long needed = mode == BUDDY && size <= current->bytes ? 1L << blockOrder(size) : size;
+    if (result < 0 && compactOnFailure && freeBytes >= needed) {
+        long moved = compactUntil(size);
+        if (moved >= 0) {
+            totals.triggered[ON_FAILURE]++;
+            totals.triggeredMoved[ON_FAILURE] += moved;
         }
-        parsed[i] = space;
-        i++;
-        space = strtok(NULL, " ");
+        result = placeProcess(p, flag);
+        if (result == 0) {
+            totals.rescued[ON_FAILURE]++;
+        }
+    } else if (result == 0 && current->compactedFrom >= 0 && needed > current->compactedFrom) {
+        totals.rescued[current->compactedBy]++;
+        current->compactedFrom = -1;
     }
 
-    if ((strcmp(parsed[0], "RL") != 0) && parsed[1]) {
-        printf(RED "\nPlease request release using the \"RL\" command.\n\n" END);
+    if (result < 0) {
+        current->compactedFrom = -1;
+        negateProcess(p->name);
+        putNode(p); /* never linked into memory */
         return -1;
     }
 
-    if (!parsed[1]) {
-        if (strcmp(parsed[0], "RL\n") == 0) {
-            printReleaseError(-1);
-        } else {
-            printf(RED "Invalid command.\n" END);
-        }
-        return -1;
+    return 0;
+}
+
+int placeProcess(struct node *p, char flag) {
+
+    if (mode == BUDDY) {
+        return buddyFit(p);
+    } else if (mode == TLSF) {
+        return tlsfFit(p);
+    } else if (mode == TABLE) {
+        return tableFit(p, flag);
     }
 
-    strtok(parsed[1], "\n");
+    if (flag == 'W') {
+        return worstFit(p);
+    } else if (flag == 'B') {
+        return bestFit(p);
+    } else if (flag == 'F') {
+        return firstFit(p);
+    } else if (flag == 'N') {
+        return nextFit(p);
+    } else if (flag == 'T') {
+        return tlsfFit(p);
+    }
 
-    makeProcessHole(parsed[1]);
+    return -1;
+}
+
+int releaseProcess(struct command *c) {
+
+    if (c->count != 2) {
+        printReleaseError(c->count > 2 ? 1 : -1);
+        return -1;
+    }
+
+    long begin = latencyClock();
+    int result = makeProcessHole(c->words[1]);
+    recordLatency(TIMED_RELEASE, latencyClock() - begin);
 
     if (debug) {
         printLinkedList();
     }
 
-    return 0;
+    return result;
 }
 
-void allocateProcessIntoHole(struct node *holeNode, struct process *processNode) {
+void allocateProcessIntoHole(struct node *holeNode, struct node *processNode) {
 
-    if (holeNode->process->size == processNode->size) {
-        holeNode->process->name = processNode->name;
-        holeNode->hole = false;
-    } else if (holeNode->process->size > processNode->size) {
-        holeNode->process->name = processNode->name;
-        
-        int previousEnd = holeNode->process->end;
-        holeNode->process->end = processNode->size + holeNode->process->start - 1;
-        holeNode->hole = false;
+    if (holeNode->size < processNode->size) {
+        printf(RED "\nNot enough room in the hole for the process... something is wrong.\n\n" END);
+        return;
+    }
 
-        struct process *newProcess = createProcess("hole", holeNode->process->size - processNode->size);
-        struct node *newHole = createHole(newProcess, holeNode->process->end + 1, previousEnd);
+    unindexHole(holeNode);
+    unbindName(holeNode);
+
+    /* the process takes the low end of the hole */
+    processNode->start = holeNode->start;
+    processNode->end = holeNode->start + processNode->size - 1;
+    processNode->hole = false;
+
+    processNode->next = holeNode->next;
+    if (holeNode->next) {
+        holeNode->next->prev = processNode;
+    } else {
+        current->tail = processNode;
+    }
 
+    if (holeNode->size == processNode->size) {
+        if (current->rover == holeNode) {
+            current->rover = processNode;
+        }
+        replaceSegment(holeNode, processNode);
+        processNode->prev = holeNode->prev;
         if (holeNode->prev) {
-            newHole->prev = holeNode->prev;
-            holeNode->prev->next = newHole;
+            holeNode->prev->next = processNode;
         } else {
-            if (holeNode == head) {
-                newHole->prev = NULL;
-                head = newHole;
-            } else {
-                printf(RED "\nHouston, we have a problem.\n\n" END);
-            }
+            current->head = processNode;
         }
+        putNode(holeNode);
+    } else {
+        /* whatever is left over stays a hole above the process */
+        processNode->prev = holeNode;
+        holeNode->next = processNode;
+        holeNode->name = "hole";
+        holeNode->start += processNode->size;
+        holeNode->size -= processNode->size;
+        if (tracing) {
+            recordEvent(HAPPENED_SPLIT, processNode->start, processNode->size, holeNode->size);
+        }
+        indexHole(holeNode);
+        indexSegment(processNode);
+    }
 
-        newHole->next = holeNode;
-        holeNode->prev = newHole;
+    bindName(processNode);
+}
 
-        holeNode->process->size = processNode->size;
+int compareHoles(const struct avlnode *a, const struct avlnode *b) {
 
-    } else if (holeNode->process->size < processNode->size) {
-        printf(RED "\nNot enough room in the hole for the process... something is wrong.\n\n" END);
+    struct node *x = containerOf(a, node, bysize);
+    struct node *y = containerOf(b, node, bysize);
+
+    if (x->size != y->size) {
+        return x->size < y->size ? -1 : 1;
+    }
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
     }
+    return 0;
 }
 
-struct node *locateProcess(char *name) {
+int compareSegments(const struct avlnode *a, const struct avlnode *b) {
 
-    node *n;
-    for (n = head; n != NULL; n = n->next) {
-        if (strcmp(n->process->name, name) == 0) {
-            return n;
+    struct node *x = containerOf(a, node, byaddr);
+    struct node *y = containerOf(b, node, byaddr);
+
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+void indexSegment(struct node *n) {
+
+    /* TLSF skips it to keep releases constant time */
+    if (mode != TLSF) {
+        avlInsert(&current->segments, &n->byaddr);
+    }
+}
+
+void unindexSegment(struct node *n) {
+
+    if (mode != TLSF) {
+        avlRemove(&current->segments, &n->byaddr);
+    }
+}
+
+void replaceSegment(struct node *old, struct node *new) {
+
+    if (mode != TLSF) {
+        avlReplace(&current->segments, &old->byaddr, &new->byaddr);
+    }
+}
+
+void indexHole(struct node *n) {
+
+    /* the TLSF engine keeps only the constant-time index */
+    if (mode != TLSF) {
+        avlInsert(&current->holes, &n->bysize);
+    }
+    binHole(n);
+
+    current->freeBytes += n->size;
+    current->holeCount++;
+    if (current->largest >= 0 && n->size > current->largest) {
+        current->largest = n->size;
+    }
+}
+
+void unindexHole(struct node *n) {
+
+    if (mode != TLSF) {
+        avlRemove(&current->holes, &n->bysize);
+    }
+    unbinHole(n);
+
+    current->freeBytes -= n->size;
+    current->holeCount--;
+    if (n->size == current->largest) {
+        current->largest = -1; /* looked up again when next needed */
+    }
+}
+
+struct node *smallestHoleOfSize(long size) {
+
+    /* a probe sorting before every real hole of this size */
+    struct node probe = { .size = size, .start = -1 };
+
+    struct avlnode *found = avlLowerBound(&current->holes, &probe.bysize);
+    return found ? containerOf(found, node, bysize) : NULL;
+}
+
+long largestHole() {
+
+    if (mode == BUDDY) {
+        if (!current->head) {
+            return 1L << (63 - __builtin_clzl(current->bytes));
+        }
+        return current->buddies.nonEmpty ? 1L << (63 - __builtin_clzl(current->buddies.nonEmpty)) : 0;
+    }
+
+    if (arenaEmpty()) {
+        return current->bytes;
+    }
+
+    if (current->largest >= 0) {
+        return current->largest;
+    }
+
+    if (mode == TABLE) {
+        return current->largest = tableLargest();
+    }
+
+    if (mode == TLSF) {
+        /* the top class is known at once, but its holes differ in size */
+        if (!current->classes.flBitmap) {
+            return current->largest = 0;
         }
+        int fl = 63 - __builtin_clzl(current->classes.flBitmap);
+        int sl = 31 - __builtin_clz(current->classes.slBitmap[fl]);
+        long largest = 0;
+        struct node *n;
+        for (n = current->classes.bins[fl][sl]; n != NULL; n = n->nextFree) {
+            if (n->size > largest) {
+                largest = n->size;
+            }
+        }
+        return current->largest = largest;
     }
 
-    return NULL;
+    struct avlnode *last = avlLast(&current->holes);
+    return current->largest = last ? containerOf(last, node, bysize)->size : 0;
+}
+
+void resetMemory() {
+
+    freeLinkedList();
+    freeNames();
+    current->tail = NULL;
+    current->allocated = 0;
+    memset(&totals, 0, sizeof(totals));
+}
+
+struct node *locateProcess(char *name) {
+
+    struct name *entry = findName(name);
+    return entry ? entry->node : NULL;
 }
 
 void printRequestError() {
 
-    printf(RED "\nToo many arguments entered in the command.\n");
-    printf("To request memory allocation, structure a command as follows:\n" END);
-    printf("\nRQ [process name] [process bytes] [algorithm flag]\n\n");
+    report(RED "\nToo many arguments entered in the command.\n");
+    report("To request memory allocation, structure a command as follows:\n" END);
+    report("\nRQ [process name] [process bytes] [algorithm flag]\n\n");
 }
 
 void printReleaseError(int howMany) {
 
     if (howMany > 0) {
-        printf(RED "\nIncorrect number of arguments entered in the command.\n");
+        report(RED "\nIncorrect number of arguments entered in the command.\n");
     } else {
-        printf(RED "\nToo few arguments entered in the command.\n");
+        report(RED "\nToo few arguments entered in the command.\n");
     }
-    printf("To request memory allocation, structure a command as follows:\n" END);
-    printf("\nRQ [process name] [number of bytes] [strategy]\n\n");
-    printf(RED "To release allocated memory, structure a command as follows:\n" END);
-    printf("\nRL [process name]\n\n");
+    report("To request memory allocation, structure a command as follows:\n" END);
+    report("\nRQ [process name] [number of bytes] [strategy]\n\n");
+    report(RED "To release allocated memory, structure a command as follows:\n" END);
+    report("\nRL [process name]\n\n");
 }
 
 void printNode(node *n) {
 
     if (debug) {
         printf("\n");
-        if (n == head) {
+        if (n == current->head) {
             printf(BLU "Head:\n" END);
         } 
-        if (n == tail) {
+        if (n == current->tail) {
             printf(BLU "Tail:\n" END);
         }
-        printf(GRN "Process %s\n" END, n->process->name);
-        printf("%d bytes\n", n->process->size);
-        printf("start addr: %d\n", n->process->start);
-        printf("  end addr: %d\n", n->process->end);
+        printf(GRN "Process %s\n" END, n->name);
+        printf("%ld bytes\n", n->size);
+        printf("start addr: %ld\n", n->start);
+        printf("  end addr: %ld\n", n->end);
         if (n->hole) {
-            printf(RED "Process %s is a hole!\n" END, n->process->name);
+            printf(RED "Process %s is a hole!\n" END, n->name);
         }
     }
 }
 
-struct process * createProcess(char *name, int size) {
+struct node * createProcess(char *name, long size) {
 
-    struct process *p;
-    p = (struct process *) malloc(sizeof(struct process));
+    struct node *p = getNode();
 
+    p->next = NULL;
+    p->prev = NULL;
     p->name = name;
     p->size = size;
     p->start = -1;
     p->end = -1;
+    p->hole = false;
+    p->order = -1;
+    p->strategy = 0;
 
     return p;
 }
 
-struct node * createHole(struct process *p, int start, int end) {
+struct node * createHole(long start, long end) {
 
-    node *new = (node *) malloc(sizeof(node));
-    new->process = p;
-
-    if ((end - start + 1) != p->size) {
-        printf(RED "\nSize in bytes and addresses do not match.\n\n" END);
-    }
+    struct node *new = createProcess("hole", end - start + 1);
 
-    new->process->start = start;
-    new->process->end = end;
+    new->start = start;
+    new->end = end;
     new->hole = true;
 
     return new;
 }
 
-void createNode(struct process *p, int start, int end) {
+void createNode(struct node *p, long start, long end) {
 
-    node *new = (node *) malloc(sizeof(node));
-    new->process = p;
+    node *new = p;
 
     if ((end - start + 1) != p->size) {
         printf(RED "\nSize in bytes and addresses do not match.\n\n" END);
     }
 
-    new->process->start = start;
-    new->process->end = end;
+    new->start = start;
+    new->end = end;
     new->hole = false;
     new->next = NULL;
     new->prev = NULL;
+    bindName(new);
+    indexSegment(new);
 
-    if (!head) {
-        head = new;
+    if (!current->head) {
+        current->head = new;
     } else {
-        new->next = head;
-        head->prev = new;
-        head = new;
+        new->next = current->head;
+        current->head->prev = new;
+        current->head = new;
     }
     
-    if (!tail) {
-        tail = new;
+    if (!current->tail) {
+        current->tail = new;
     }
 }
 
@@ -699,27 +1060,64 @@ void printLinkedList() {
 
     node *n;
     printf("\n");
-    for (n = head; n != NULL; n = n->next) {
+    for (n = current->head; n != NULL; n = n->next) {
         printNode(n);
     }
 }
 
 int makeProcessHole(char *name) {
 
-    struct node *n;
-    n = locateProcess(name);
+    if (mode == TABLE) {
+        return tableRelease(name);
+    }
+
+    /* look where the process would have gone first, then everywhere */
+    struct node *n = NULL;
+    int home = homeArena(name);
+    int i;
+    for (i = 0; i < arenaCount && !n; i++) {
+        struct arena *a = &arenas[(home + i) % arenaCount];
+        lockArena(a);
+        current = a;
+        n = locateProcess(name);
+        if (!n) {
+            unlockArena(a);
+        }
+    }
+
     if (!n) {
-        printf(RED "\nProcess %s not located in memory.\n\n" END, name);
+        report(RED "\nProcess %s not located in memory.\n\n" END, name);
         return -1;
     }
 
     if (n->hole) {
-        printf(YEL "\nProcess %s has already been released from memory, creating a hole from\n", name);
-        printf("%d to %d, of size %d bytes.\n\n" END, n->process->start, n->process->end, n->process->size);
+        report(YEL "\nProcess %s has already been released from memory, creating a hole from\n", name);
+        report("%ld to %ld, of size %ld bytes.\n\n" END, current->base + n->start, current->base + n->end, n->size);
     } else {
-        printf(PUR "\nProcess %s released from memory (%d bytes).\n\n" END, n->process->name, n->process->size);
-        n->hole = true;
-        allocated -= n->process->size;
+        report(PUR "\nProcess %s released from memory (%ld bytes).\n\n" END, n->name, n->size);
+        releaseInArena(n);
+        compactAfterRelease();
+    }
+
+    unlockArena(current);
+    return 0;
+}
+
+void releaseInArena(struct node *n) {
+
+    n->hole = true;
+    current->allocated -= n->size;
+    if (!relocating) {
+        totals.released++;
+        if (tracing) {
+            recordEvent(HAPPENED_RELEASE, n->start, n->size, 0);
+        }
+    }
+
+    if (mode == BUDDY) {
+        buddyRelease(n);
+    } else {
+        indexHole(n);
 
         if (debug) {
             printNode(n);
@@ -743,114 +1141,446 @@ int makeProcessHole(char *name) {
             }
         }
     }
+}
+
+int resizeProcess(struct command *c) {
+
+    long size;
+    char flag = 0;
+    if (c->count < 3 || c->count > 4 || !parseNumber(c->words[2], &size) ||
+        (c->count == 4 && !parseStrategy(c->words[3], &flag))) {
+        report(RED "\nTo resize a process, structure a command as follows:\n" END);
+        report("\nRS [process name] [number of bytes] [strategy, if it has to move]\n\n");
+        return -1;
+    }
+
+    if (size <= 0) {
+        report(RED "\nPlease enter a valid positive number of bytes.\n\n" END);
+        return -1;
+    }
+
+    long begin = latencyClock();
+    int result = resizeNamed(c->words[1], size, flag);
+    recordLatency(TIMED_RESIZE, latencyClock() - begin);
+    return result;
+}
+
+int resizeNamed(char *name, long size, char flag) {
+
+    if (mode == TABLE) {
+        return tableResize(name, size, flag);
+    }
+
+    /* look where the process would have gone first, then everywhere */
+    struct node *n = NULL;
+    int home = homeArena(name);
+    int i;
+    for (i = 0; i < arenaCount && !n; i++) {
+        struct arena *a = &arenas[(home + i) % arenaCount];
+        lockArena(a);
+        current = a;
+        n = locateProcess(name);
+        if (!n) {
+            unlockArena(a);
+        }
+    }
+
+    if (!n || n->hole) {
+        report(RED "\nProcess %s is not in memory.\n\n" END, name);
+        if (n) {
+            unlockArena(current);
+        }
+        return -1;
+    }
+
+    long oldSize = n->size;
+    int result = mode == BUDDY ? buddyResize(n, size) : resizeInPlace(n, size);
+    if (result == 0) {
+        totals.resized++;
+        if (current->data && size > oldSize) {
+            resizeData(n, n->start, oldSize);
+        }
+        report(GRN "\nProcess %s resized in place from %ld to %ld bytes.\n\n" END, name, oldSize, size);
+    } else {
+        result = relocateProcess(n, size, flag ? flag : n->strategy ? n->strategy : mode == TLSF ? 'T' : 'F');
+    }
+
+    unlockArena(current);
+    return result;
+}
+
+int resizeInPlace(struct node *n, long size) {
+
+    long difference = size - n->size;
+    struct node *above = n->prev;
+
+    if (difference < 0) {
+        /* the freed tail joins the hole above, or becomes one */
+        if (above && above->hole) {
+            unindexHole(above);
+            above->start += difference;
+            above->size -= difference;
+            indexHole(above);
+        } else {
+            struct node *h = createHole(n->end + difference + 1, n->end);
+            h->next = n;
+            h->prev = above;
+            n->prev = h;
+            if (above) {
+                above->next = h;
+            } else {
+                current->head = h;
+            }
+            indexHole(h);
+            indexSegment(h);
+        }
+    } else if (difference > 0) {
+        if (!above || !above->hole || above->size < difference) {
+            return -1;
+        }
+
+        unindexHole(above);
+        if (above->size == difference) {
+            /* the hole disappears into the process */
+            unindexSegment(above);
+            unbindName(above);
+            n->prev = above->prev;
+            if (above->prev) {
+                above->prev->next = n;
+            } else {
+                current->head = n;
+            }
+            if (current->rover == above) {
+                current->rover = n;
+            }
+            putNode(above);
+        } else {
+            above->start += difference;
+            above->size -= difference;
+            indexHole(above);
+        }
+    }
+
+    n->size = size;
+    n->end += difference;
+    current->allocated += difference;
+    return 0;
+}
+
+int relocateProcess(struct node *n, long size, char flag) {
+
+    /* like realloc, the new place is found while the old one is still
+       taken, so a failed move leaves the process as it was */
+    struct node *p = createProcess(n->name, size);
+    p->strategy = flag;
+    relocating = true;
+    int result = placeProcess(p, flag);
+    relocating = false;
+    if (result < 0) {
+        putNode(p);
+        totals.resizeFailed++;
+        report(RED "\nNot enough memory is available to resize process %s to %ld bytes.\n\n" END, n->name, size);
+        return -1;
+    }
 
+    if (current->data) {
+        resizeData(p, n->start, n->size);
+    }
+    report(GRN "\nProcess %s moved from %ld to %ld to be resized from %ld bytes.\n\n" END, p->name,
+           current->base + n->start, current->base + p->start, n->size);
+    if (tracing) {
+        recordEvent(HAPPENED_RESIZE, p->start, p->size, n->start);
+    }
+
+    /* the name already belongs to the new node, so the old one is
+       released as a nameless hole */
+    n->name = "hole";
+    relocating = true;
+    releaseInArena(n);
+    relocating = false;
+
+    totals.relocated++;
     return 0;
 }
 
 void combineHoles(struct node *a, struct node *b) {
 
     if (debug) {
-        printf(YEL "Combining holes %s and %s\n", a->process->name, b->process->name);
+        printf(YEL "Combining holes %s and %s\n", a->name, b->name);
     }
+
+    unindexHole(a);
+    unindexHole(b);
+    unindexSegment(a);
     
     b->next = a->next;
     if (a->next) {
         a->next->prev = a->prev;
     }
-    b->process->size += a->process->size;
-    b->process->start = a->process->start;
+    b->size += a->size;
+    b->start = a->start;
 
-    if (a == tail) {
-        tail = b;
+    if (a == current->tail) {
+        current->tail = b;
     }
 
-    free(a->process);
-    free(a);
+    indexHole(b);
+    if (tracing) {
+        recordEvent(HAPPENED_COALESCE, b->start, b->size, 2);
+    }
+
+    if (current->rover == a) {
+        current->rover = b;
+    }
+
+    unbindName(a);
+    putNode(a);
 }
 
 void combineThreeHoles(struct node *a, struct node *b, struct node *c) {
 
     if (debug) {
-        printf(YEL "Combining holes %s, %s, and %s\n", a->process->name, b->process->name, c->process->name);
+        printf(YEL "Combining holes %s, %s, and %s\n", a->name, b->name, c->name);
     }
 
+    unindexHole(a);
+    unindexHole(b);
+    unindexHole(c);
+    unindexSegment(a);
+    unindexSegment(b);
+
     c->next = a->next;
     if (a->next) {
         a->next->prev = b->prev;
     }
-    c->process->size += b->process->size + a->process->size;
-    c->process->start = a->process->start;
+    c->size += b->size + a->size;
+    c->start = a->start;
+
+    if (a == current->tail) {
+        current->tail = c;
+    }
 
-    if (a == tail) {
-        tail = c;
+    indexHole(c);
+    if (tracing) {
+        recordEvent(HAPPENED_COALESCE, c->start, c->size, 3);
     }
 
-    free(b->process);
-    free(b);
-    free(a->process);
-    free(a);
+    if (current->rover == a || current->rover == b) {
+        current->rover = c;
+    }
+
+    unbindName(b);
+    unbindName(a);
+    putNode(b);
+    putNode(a);
 }
 
 void freeLinkedList() {
 
     struct node * n;
-    while (head) {
-        n = head;
-        head = head->next;
+    current->holes.root = NULL;
+    current->segments.root = NULL;
+    current->rover = NULL;
+    memset(&current->buddies, 0, sizeof(current->buddies));
+    memset(&current->classes, 0, sizeof(current->classes));
+    freeTable();
+    current->freeBytes = 0;
+    current->holeCount = 0;
+    current->largest = 0;
+    current->releases = 0;
+    current->compactedFrom = -1;
+    while (current->head) {
+        n = current->head;
+        current->head = current->head->next;
         if (debug) {
-            printf("freeing process %s... ", n->process->name);
+            printf("freeing process %s... ", n->name);
         }
-        free(n->process);
-        free(n);
+        putNode(n);
         if (debug) {
             printf(GRN "freed.\n" END);
         }
     }
 }
 
-void addName(char *n) {
+struct node *getNode() {
 
-    struct name *new = (struct name *) malloc(sizeof(struct name));
+    if (!current->spareNodes) {
+        struct slab *s = (struct slab *) malloc(sizeof(struct slab) + sizeof(struct node) * SLAB_NODES);
+        s->next = current->slabs;
+        current->slabs = s;
 
-    char *noP = n + 1;   /* increment char * to just the number portion */
-    int num = atoi(noP); /* convert char * to int */
+        int i;
+        for (i = SLAB_NODES - 1; i >= 0; i--) {
+            s->nodes[i].next = current->spareNodes;
+            current->spareNodes = &s->nodes[i];
+        }
+    }
 
-    new->processNum = num;
-    new->next = NULL;
-    new->prev = NULL;
+    struct node *n = current->spareNodes;
+    current->spareNodes = n->next;
+    return n;
+}
 
-    if (!namehead) {
-        namehead = new;
-    } else {
-        new->next = namehead;
-        namehead->prev = new;
-        namehead = new;
+void putNode(struct node *n) {
+
+    n->next = current->spareNodes;
+    current->spareNodes = n;
+}
+
+void freeNodePool() {
+
+    struct slab *s;
+    while (current->slabs) {
+        s = current->slabs;
+        current->slabs = current->slabs->next;
+        free(s);
     }
+    current->spareNodes = NULL;
 }
 
-void freeNames() {
+char *internName(char *n) {
 
-    struct name * n;
-    while (namehead) {
-        n = namehead;
-        namehead = namehead->next;
-        if (debug) {
-            printf("freeing name %d... ", n->processNum);
+    size_t length = strlen(n) + 1;
+
+    if (!current->nameblocks || current->nameblocks->used + length > current->nameblocks->capacity) {
+        size_t capacity = length > NAME_BLOCK ? length : NAME_BLOCK;
+        struct nameblock *b = (struct nameblock *) malloc(sizeof(struct nameblock) + capacity);
+        b->next = current->nameblocks;
+        b->used = 0;
+        b->capacity = capacity;
+        current->nameblocks = b;
+    }
+
+    char *copy = current->nameblocks->text + current->nameblocks->used;
+    memcpy(copy, n, length);
+    current->nameblocks->used += length;
+    return copy;
+}
+
+unsigned hashName(char *n) {
+
+    /* FNV-1a */
+    unsigned h = 2166136261u;
+    for (; *n; n++) {
+        h ^= (unsigned char) *n;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* returns the slot holding a name, or the empty slot where it belongs */
+struct name *nameSlot(char *n, unsigned hash) {
+
+    int mask = current->namecap - 1;
+    int i;
+    for (i = hash & mask; current->names[i].str; i = (i + 1) & mask) {
+        if (current->names[i].hash == hash && strcmp(current->names[i].str, n) == 0) {
+            break;
         }
-        free(n);
-        if (debug) {
-            printf(GRN "freed.\n" END);
+    }
+    return &current->names[i];
+}
+
+void growNames() {
+
+    struct name *old = current->names;
+    int oldcap = current->namecap;
+
+    current->namecap = current->namecap ? current->namecap * 2 : 64;
+    current->names = (struct name *) calloc(current->namecap, sizeof(struct name));
+
+    int i;
+    for (i = 0; i < oldcap; i++) {
+        if (old[i].str) {
+            *nameSlot(old[i].str, old[i].hash) = old[i];
         }
     }
+    free(old);
+}
+
+struct name *findName(char *n) {
+
+    if (current->namecount == 0) {
+        return NULL;
+    }
+
+    struct name *slot = nameSlot(n, hashName(n));
+    return slot->str ? slot : NULL;
+}
+
+char *addName(char *n) {
+
+    /* keep the load factor under 3/4 so probe chains stay short */
+    if ((current->namecount + 1) * 4 > current->namecap * 3) {
+        growNames();
+    }
+
+    unsigned hash = hashName(n);
+    struct name *slot = nameSlot(n, hash);
+
+    if (!slot->str) {
+        slot->str = internName(n);
+        slot->hash = hash;
+        slot->node = NULL;
+        slot->start = -1;
+        current->namecount++;
+    }
+
+    return slot->str;
+}
+
+void bindName(struct node *n) {
+
+    struct name *entry = findName(n->name);
+    if (entry) {
+        entry->node = n;
+    }
+}
+
+void unbindName(struct node *n) {
+
+    struct name *entry = findName(n->name);
+    if (entry && entry->node == n) {
+        entry->node = NULL;
+    }
+}
+
+void freeNames() {
+
+    int i;
+    for (i = 0; i < current->namecap; i++) {
+        if (current->names[i].str) {
+            if (debug) {
+                printf("freeing name %s... ", current->names[i].str);
+            }
+        }
+    }
+
+    free(current->names);
+    current->names = NULL;
+    current->namecap = 0;
+    current->namecount = 0;
+
+    struct nameblock *b;
+    while (current->nameblocks) {
+        b = current->nameblocks;
+        current->nameblocks = current->nameblocks->next;
+        free(b);
+    }
+    if (debug) {
+        printf(GRN "names freed.\n" END);
+    }
 }
 
 void printNames() {
 
     if (debug) {
         printf("\n-----------------\n");
-        struct name *n;
-        for (n = namehead; n != NULL; n = n->next) {
-            printf(BLU "Process number: %d\n" END, n->processNum);
+        int i;
+        for (i = 0; i < current->namecap; i++) {
+            if (current->names[i].str) {
+                printf(BLU "Process name: %s\n" END, current->names[i].str);
+            }
         }
         printf("-----------------\n");
     }
@@ -858,33 +1588,50 @@ void printNames() {
 
 bool duplicate(char *name) {
 
-    char *noP = name + 1;
-    int num = atoi(noP);
-
-    struct name *n;
-    for (n = namehead; n != NULL; n = n->next) {
-        if (n->processNum == num) {
-            return true;
-        }
-    }
-
-    return false;
+    return findName(name) != NULL;
 }
 
 void negateProcess(char *name) {
 
-    char *noP = name + 1;
-    int num = atoi(noP);
+    if (current->namecount == 0) {
+        return;
+    }
+
+    struct name *slot = nameSlot(name, hashName(name));
+    if (!slot->str) {
+        return;
+    }
 
-    struct name *n;
-    for (n = namehead; n != NULL; n = n->next) {
-        if (n->processNum == num) {
-            n->processNum = -100000;
+    /* the name was almost certainly the last one interned, in which
+       case its bytes can be handed back */
+    size_t length = strlen(slot->str) + 1;
+    if (current->nameblocks && slot->str + length == current->nameblocks->text + current->nameblocks->used) {
+        current->nameblocks->used -= length;
+    }
+    current->namecount--;
+
+    /* backward-shift deletion: pull later members of the probe chain
+       into the gap so lookups never need tombstones */
+    int mask = current->namecap - 1;
+    int i = slot - current->names;
+    int j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (!current->names[j].str) {
+            break;
+        }
+        int home = current->names[j].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            current->names[i] = current->names[j];
+            i = j;
         }
     }
+    current->names[i].str = NULL;
+    current->names[i].node = NULL;
 }
 
 void noMemoryLeft(char *name) {
 
-    printf(RED "\nNot enough memory is available to allocate process %s.\n\n" END, name);
+    totals.failed++;
+    report(RED "\nNot enough memory is available to allocate process %s.\n\n" END, name);
 }
\ No newline at end of file
@@ -0,0 +1,768 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "avl.h"
+
+#define BLU "\x1B[34m"
+#define GRN "\x1B[32m"
+#define YEL "\x1B[33m"
+#define PUR "\x1B[35m"
+#define RED "\x1B[31m"
+#define END "\x1B[0m"
+
+/* The maximum number of bytes in virtual memory, 256 TiB unless built
+   with -DMAX=... Addresses and sizes are longs, so 64 bits wide */
+#ifndef MAX
+#define MAX (1L << 48)
+#endif
+
+extern __thread long bytes; /* The total number of bytes requested by the user */
+
+extern bool debug; /* boolean to determine whether or not to print info */
+extern bool batch; /* boolean to determine if replaying a trace without prompts */
+extern __thread bool quiet; /* silences per-process messages while a batch command runs */
+extern __thread bool relocating; /* set while a resize moves a process, which is
+                                    neither a request nor a release */
+extern bool compactOnFailure; /* compact just enough to satisfy a failed request */
+extern double compactAbove; /* compact an arena once a release leaves its external
+                               fragmentation above this fraction, 0 if never */
+extern long compactEvery; /* compact an arena after this many releases, 0 if never */
+extern bool backed; /* whether processes have real memory behind them */
+
+#define REMAP_PAGES 16 /* pages a move needs before they are remapped, not copied */
+
+typedef enum trigger {
+    ON_FAILURE, /* a request found no hole large enough */
+    ON_FRAGMENTATION, /* a release left fragmentation above compactAbove */
+    ON_RELEASES, /* an arena saw compactEvery releases since it was compacted */
+    TRIGGERS /* number of automatic compaction policies */
+} trigger;
+
+typedef enum engine {
+    LIST, /* address-ordered list placed by first, best, worst or next fit */
+    BUDDY, /* binary buddy system over power-of-two blocks */
+    TLSF, /* the list of holes, indexed only by two-level segregated fit */
+    TABLE /* address-ordered arrays of segments placed by first, best, worst or next fit */
+} engine;
+
+extern enum engine mode; /* which engine manages memory, chosen at startup */
+
+#define MAX_WORDS 5 /* words of a command kept, one more than the longest takes */
+
+typedef struct command {
+    char *words[MAX_WORDS]; /* the first words of the line, split where they lie */
+    int count; /* words on the line, which may be more than are kept */
+} command;
+
+typedef struct summary {
+    long commands; /* commands read */
+    long placed; /* requests that were given memory */
+    long failed; /* requests turned away for lack of memory */
+    long released; /* processes released from memory */
+    long compactions; /* times memory was compacted */
+    long moved; /* bytes of processes relocated by compaction */
+    long errors; /* commands rejected as malformed or invalid */
+    long triggered[TRIGGERS]; /* compactions each policy ran */
+    long triggeredMoved[TRIGGERS]; /* bytes each policy's compactions moved */
+    long rescued[TRIGGERS]; /* requests placed that would have failed without them */
+    long copied; /* bytes of backing memory copied by compaction */
+    long remapped; /* bytes of backing memory moved by remapping pages */
+    long copyTime; /* nanoseconds spent moving backing memory */
+    long corrupted; /* processes whose bytes did not survive a move */
+    long resized; /* processes resized where they were */
+    long relocated; /* processes moved to be resized */
+    long resizeFailed; /* resizes turned away for lack of memory */
+} summary;
+
+extern __thread struct summary totals; /* what the calling thread did during this run */
+
+typedef struct name {
+    char *str; /* interned process name, NULL if the slot is empty */
+    unsigned hash; /* cached hash of str */
+    struct node *node; /* node carrying this name, NULL once it is merged away */
+    long start; /* start of the process carrying this name in the table
+                   engine, -1 once it is released */
+} name;
+
+typedef struct node {
+    struct node *next; /* pointer to the next node in the list */
+    struct node *prev; /* pointer to the previous node in the list */
+    char *name; /* name of the process (i.e. P0), "hole" for holes */
+    long size; /* size to allocate in bytes */
+    long start; /* start address in virtual memory */
+    long end; /* end address in virtual memory */
+    bool hole; /* flag to determine if node is a hole */
+    char strategy; /* flag the process was placed with, 0 if not known */
+    struct avlnode bysize; /* link in the size-ordered hole index */
+    struct avlnode byaddr; /* link in the address-ordered segment index */
+    int order; /* log2 of the block size in buddy mode, -1 otherwise */
+    struct node *nextFree; /* next free block of the same order or size class */
+    struct node *prevFree; /* previous free block of the same order or size class */
+} node;
+
+#define SLAB_NODES 4096 /* nodes carved out of each slab */
+#define NAME_BLOCK 65536 /* bytes of name storage allocated at a time */
+
+typedef struct slab {
+    struct slab *next; /* the previously allocated slab */
+    struct node nodes[]; /* SLAB_NODES nodes handed out by getNode(), or
+                            every node of a restored snapshot */
+} slab;
+
+typedef struct nameblock {
+    struct nameblock *next; /* the previously filled block */
+    size_t used; /* bytes of text handed out so far */
+    size_t capacity; /* bytes of text in the block */
+    char text[]; /* interned names, each null terminated */
+} nameblock;
+
+#define BUDDY_ORDERS 63 /* block sizes 2^0 through 2^62 */
+
+typedef struct buddy {
+    struct node *free[BUDDY_ORDERS]; /* free blocks of each order */
+    unsigned long nonEmpty; /* bit k is set while free[k] holds a block */
+    long reserved; /* bytes of the blocks handed to processes */
+} buddy;
+
+#define SL_LOG2 4 /* log2 of the second-level classes per power of two */
+#define SL_COUNT (1 << SL_LOG2) /* second-level classes per power of two */
+#define FL_COUNT 60 /* first-level classes: sizes below 16, then 2^4 to 2^62 */
+
+typedef struct segregated {
+    unsigned long flBitmap; /* bit f is set while any class of first level f is non-empty */
+    unsigned slBitmap[FL_COUNT]; /* bit s of entry f is set while class (f, s) is non-empty */
+    struct node *bins[FL_COUNT][SL_COUNT]; /* holes of each size class */
+} segregated;
+
+/* an arena's segments in the table engine, held in chunks of arrays kept
+   private to table.c */
+struct chunk;
+
+typedef struct table {
+    struct chunk **chunks; /* chunks of segments, lowest addresses first */
+    int count; /* chunks in use */
+    int capacity; /* chunk pointers allocated */
+    long rover; /* start of the segment next fit resumes its search from,
+                   -1 until it has placed a process */
+} table;
+
+typedef struct arena {
+    long base; /* first address of the arena in memory */
+    char *data; /* the arena's backing memory, NULL unless backed */
+    long bytes; /* size of the arena in bytes */
+    long allocated; /* bytes in use by processes in the arena */
+    struct node *head; /* head of the doubly linked list of processes */
+    struct node *tail; /* tail of the doubly linked list of processes */
+    struct name *names; /* open-addressed table of process names in use */
+    int namecap; /* number of slots in the name table (a power of two) */
+    int namecount; /* number of occupied slots in the name table */
+    struct nameblock *nameblocks; /* storage for interned names, newest first */
+    struct slab *slabs; /* every slab of nodes allocated so far */
+    struct node *spareNodes; /* nodes not in use, linked through next */
+    struct avltree holes; /* every hole in the arena, smallest first */
+    struct avltree segments; /* every segment in the arena, by start address */
+    struct node *rover; /* where next fit resumes its search */
+    struct buddy buddies; /* free lists of the buddy engine */
+    struct segregated classes; /* holes binned by size class for TLSF */
+    struct table table; /* the segments, when the table engine keeps them */
+    long freeBytes; /* bytes in holes, counted as holes are indexed */
+    int holeCount; /* number of holes, counted the same way */
+    long largest; /* size of the largest hole, -1 once it is taken until
+                    it is looked up again */
+    long releases; /* releases since the arena was last compacted by a policy */
+    long compactedFrom; /* largest hole before the last compaction on fragmentation
+                           or releases, -1 if there was none, a request it
+                           rescued has been counted or a request has failed
+                           since */
+    enum trigger compactedBy; /* which policy ran that compaction */
+    pthread_mutex_t lock; /* held by the thread working in the arena */
+} arena;
+
+typedef struct metrics {
+    long freeBytes; /* bytes in holes */
+    int holeCount; /* number of holes */
+    long largest; /* size of the largest hole */
+    long allocated; /* bytes in use by processes */
+} metrics;
+
+typedef struct sample {
+    long command; /* commands run when the sample was taken */
+    struct metrics m; /* the counters at that point */
+} sample;
+
+#define SAMPLE_RING 4096 /* samples kept, the oldest overwritten first */
+
+extern int sampleEvery; /* commands between samples, 0 if not sampling */
+
+typedef enum routing {
+    BYNAME, /* a process goes first to the arena its name hashes to */
+    BYTHREAD /* a process goes first to the arena of the worker asking */
+} routing;
+
+extern __thread struct arena *arenas; /* the arenas memory is split into */
+extern __thread int arenaCount; /* number of arenas */
+extern int workers; /* threads replaying a trace, 1 unless running threaded */
+extern enum routing policy; /* which arena a process tries first */
+extern __thread struct arena *current; /* the arena the calling thread works in */
+extern __thread int worker; /* index of the calling worker thread */
+
+/* Memory, its size and its arenas belong to the thread that set them up,
+   so several allocators can run side by side on their own threads. A
+   thread replaying part of a trace joins the memory of the one that
+   started it through an instance */
+
+typedef struct instance {
+    long bytes; /* size of memory */
+    struct arena *arenas; /* the arenas memory is split into */
+    int arenaCount; /* number of arenas */
+} instance;
+
+/* splits memory into count arenas of (nearly) equal size, leaving the
+   calling thread in the first */
+void setupArenas(int count);
+
+/* frees every arena's segments, names and nodes */
+void freeArenas();
+
+/* records the calling thread's memory / makes the calling thread work in
+   a recorded memory, starting in its first arena */
+void saveInstance(struct instance *i);
+void useInstance(struct instance *i);
+
+/* takes / gives back an arena's lock, only needed with several workers */
+void lockArena(struct arena *a);
+void unlockArena(struct arena *a);
+
+/* returns the index of the arena a process tries first */
+int homeArena(char *name);
+
+/* returns true while nothing has been placed in the current arena */
+bool arenaEmpty();
+
+/* returns the arena holding a memory address */
+struct arena *arenaOf(long address);
+
+/* adds up what two threads did */
+void addTotals(struct summary *into, struct summary *from);
+
+/* adds the current arena's counters to m */
+void arenaMetrics(struct metrics *m);
+
+/* adds up the counters of every arena, without walking memory */
+void gatherMetrics(struct metrics *m);
+
+/* returns the share of free bytes outside the largest hole */
+double externalFragmentation(struct metrics *m);
+
+/* reports the counters of every arena ("STATS") */
+void printStats();
+
+/* starts sampling the counters every few commands into a ring */
+void setupSampler(int every);
+void freeSampler();
+
+/* records the counters in the ring if a sample is due */
+void takeSample();
+
+/* writes the samples in the ring as CSV, oldest first, to a file or
+   standard output ("SAMPLES [file]") */
+int dumpSamples(struct command *c);
+
+/* orders holes by size, then by start address */
+int compareHoles(const struct avlnode *a, const struct avlnode *b);
+
+/* orders segments by start address */
+int compareSegments(const struct avlnode *a, const struct avlnode *b);
+
+/* creates and returns a process node, initializing name and size */
+struct node * createProcess(char *name, long size); 
+
+/* takes a node from the pool, carving a new slab if it is empty */
+struct node *getNode();
+
+/* returns a node to the pool */
+void putNode(struct node *n);
+
+/* frees every slab in the pool */
+void freeNodePool();
+
+/* copies a name into the current name block */
+char *internName(char *n);
+
+/* releases a process from memory, if present, creating a hole
+   ("RL name") */
+int releaseProcess(struct command *c);
+
+/* creates a hole in memory and merges said hole with surrounding holes */
+int makeProcessHole(char *name);
+
+/* grows or shrinks a process ("RS name size [strategy]") */
+int resizeProcess(struct command *c);
+
+/* the parsed form of resizeProcess- a process that cannot be resized
+   where it is moves to wherever the strategy (or, if it is 0, the one it
+   was placed with) finds room. Returns -1 if it could not be resized */
+int resizeNamed(char *name, long size, char flag);
+
+/* resizes a process of the current arena without moving it, shrinking
+   into / growing out of the hole above it- returns -1 if it cannot */
+int resizeInPlace(struct node *n, long size);
+
+/* places a process of the new size elsewhere and releases the old one,
+   returning -1 if there is no room */
+int relocateProcess(struct node *n, long size, char flag);
+
+/* turns a process of the current arena into a hole */
+void releaseInArena(struct node *n);
+
+/* places a process node at the head of the list given start & end addresses */
+void createNode(struct node *p, long start, long end);
+
+/* prints the doubly linked list */
+void printLinkedList();
+
+/* frees the doubly linked list from memory */
+void freeLinkedList();
+
+/* locates and returns a process in the doubly linked list- 
+   returns null if process is not in the list */
+struct node *locateProcess(char *name);
+
+/* allocates a process in memory according to Worst Fit, Best Fit,
+   First Fit, Next Fit or TLSF algorithm (indicated by the flag) only if
+   there is a hole large enough for the requested allocation size
+   ("RQ name size strategy") */
+int allocateProcess(struct command *c);
+
+/* the parsed form of allocateProcess- returns 0 if the process was
+   placed, 1 if there was not enough memory, -1 if the name is taken */
+int requestProcess(char *name, long size, char flag);
+
+/* places a process in the current arena, compacting first if allowed,
+   returning -1 if it does not fit */
+int requestInArena(char *name, long size, char flag);
+
+/* runs the fit function for a strategy flag, returning -1 if the
+   process did not fit */
+int placeProcess(struct node *p, char flag);
+
+/* searches the name table for duplicates and returns
+   true if duplicate found, false if not */
+bool duplicate(char *name);
+
+/* negates a processes' name if a memory size is caught, so
+   the user can reuse the unsuccessful process' name again */
+void negateProcess(char *name);
+
+/* combines two adjacent holes into one node */
+void combineHoles(struct node *b, struct node *a);
+
+/* combines three adjacent holes into one node */
+void combineThreeHoles(struct node *a, struct node *b, struct node *c);
+
+/* creates and returns a hole node */
+struct node * createHole(long start, long end);
+
+/* allocates a process into a hole that was previously a process */
+void allocateProcessIntoHole(struct node *holeNode, struct node *processNode);
+
+/* adds a hole node to / removes a hole node from the size indexes */
+void indexHole(struct node *n);
+void unindexHole(struct node *n);
+
+/* adds a segment to / removes a segment from the address index. Nodes
+   never change places in memory, so a start address may be edited in
+   place as long as it stays between its neighbours' */
+void indexSegment(struct node *n);
+void unindexSegment(struct node *n);
+
+/* hands a segment's place in the address index to a node taking over
+   its start address */
+void replaceSegment(struct node *old, struct node *new);
+
+/* returns the segment holding an address, NULL if memory is empty */
+struct node *segmentAt(long address);
+
+/* prints the segment holding an address ("AT address") */
+int lookupAddress(struct command *c);
+
+/* prints every segment overlapping a range of addresses
+   ("RANGE start end") */
+int lookupRange(struct command *c);
+
+/* prints one line of STAT */
+void printSegment(struct node *n);
+
+/* returns the first hole of at least size bytes in (size, start)
+   order, NULL if no hole is large enough */
+struct node *smallestHoleOfSize(long size);
+
+/* print the fields of a given node */
+void printNode(node *n);
+
+/* print the names of processes previously allocated */
+void printNames();
+
+/* free the table holding names of processes */
+void freeNames();
+
+/* add a name to the table holding names of processes and
+   return the interned copy */
+char *addName(char *n);
+
+/* returns the FNV-1a hash of a name */
+unsigned hashName(char *n);
+
+/* returns the table entry for a name, NULL if it is not in use */
+struct name *findName(char *n);
+
+/* points a name's table entry at / away from the node carrying it */
+void bindName(struct node *n);
+void unbindName(struct node *n);
+
+/* places every process of a list, sorted by arena and largest first,
+   in one walk of the segments for first and next fit ("RQB name size
+   name size ... strategy")- returns -1 if any name was taken */
+int requestBatch(struct command *c);
+
+/* releases every process of a list of names and prefixes ending in '*',
+   merging the holes they leave in one pass ("RLB name prefix* ...")-
+   returns -1 if any name was not in memory */
+int releaseBatch(struct command *c);
+
+/* allocates a given process into the largest hole in memory,
+   returning -1 if it does not fit */
+int worstFit(struct node *p);
+
+/* allocates a given process into the smallest hole in memory
+   that is large enough for said process, returning -1 if none is */
+int bestFit(struct node *p);
+
+/* allocate a given process into the first hole in memory that is
+   large enough (first meaning starting from address 0), returning
+   -1 if none is */
+int firstFit(struct node *p);
+
+/* allocate a given process into the first hole large enough, searching
+   upwards from where the previous process was placed and wrapping
+   around at the top of memory, returning -1 if none is */
+int nextFit(struct node *p);
+
+/* places a process at address 0 of empty memory, returning -1 if it is
+   larger than memory */
+int allocateIntoEmptyMemory(struct node *p);
+
+/* accounts for and announces a newly placed process */
+void processCreated(struct node *p);
+
+/* returns the size of the largest hole in the current arena */
+long largestHole();
+
+/* releases every process and forgets every name, leaving the current
+   arena empty */
+void resetMemory();
+
+/* reports the status of memory */
+void stat();
+
+/* compacts all holes into one hole and places all processes
+   adjacent to each other */
+void compact();
+
+/* compacts the current arena, returning the bytes moved */
+long compactArena();
+
+/* runs the policies that compact an arena after a release, if any is due */
+void compactAfterRelease();
+
+/* prints what each automatic compaction policy did */
+void printPolicies(struct summary *s);
+
+/* maps real memory behind the calling thread's arenas if backed,
+   returning -1 if it cannot / unmaps it again */
+int mapBacking();
+void unmapBacking();
+
+/* writes a process's pattern into its backing memory / returns true if
+   the pattern is still there */
+void fillData(struct node *p);
+bool checkData(struct node *p);
+
+/* moves a process's bytes from an old start to its new one, remapping
+   whole pages where it can, and checks they arrived */
+void moveData(struct node *p, long from);
+
+/* after a process is resized, moves its bytes from its old start if it
+   moved and checks they arrived, or writes the pattern of its new tail */
+void resizeData(struct node *p, long from, long oldSize);
+
+/* moves the bytes of blocks that may land on each other, from their old
+   starts to their new ones, and checks they arrived */
+void moveBlocks(struct node **blocks, long *from, int count);
+
+/* prints how much backing memory compaction moved and how fast */
+void printBacking(struct summary *s);
+
+/* compacts only the run of segments that is cheapest to slide together
+   into a hole of at least size bytes- returns the bytes moved, or -1
+   if fewer than size bytes are free */
+long compactUntil(long size);
+
+/* moves the processes between first and last (inclusive, first at the
+   lowest address) down against each other in place, leaving the free
+   bytes as one hole on top- returns the bytes moved */
+long slideProcesses(struct node *first, struct node *last);
+
+/* returns the order of the smallest block that holds size bytes */
+int blockOrder(long size);
+
+/* splits [start, end] into the largest aligned free blocks that fit,
+   linking them above the current head */
+void addFreeBlocks(long start, long end);
+
+/* adds a block to / removes a block from the free list of its order */
+void pushFreeBlock(struct node *n);
+void removeFreeBlock(struct node *n);
+
+/* places a process in the smallest free block of a large enough order,
+   splitting larger blocks as needed- returns -1 if none is free */
+int buddyFit(struct node *p);
+
+/* resizes a block without moving it, halving it or merging it with
+   its free upper buddies- returns -1 if it cannot */
+int buddyResize(struct node *n, long size);
+
+/* frees a released process's block and merges it with its buddy for
+   as long as the buddy is free too */
+void buddyRelease(struct node *n);
+
+/* orders pointers to nodes by start address, for qsort */
+int compareStarts(const void *a, const void *b);
+
+/* repacks every block from address 0 up, largest first, so the free
+   blocks end up on top- returns the bytes moved */
+long buddyCompact();
+
+/* returns the bytes lost to rounding requests up to a block size */
+long internalFragmentation();
+
+/* finds the size class a hole of size bytes is filed under */
+void sizeClass(long size, int *fl, int *sl);
+
+/* files a hole under / removes a hole from its size class */
+void binHole(struct node *n);
+void unbinHole(struct node *n);
+
+/* returns a hole of at least size bytes in constant time, taken from
+   the first non-empty class whose every hole is large enough- NULL if
+   there is none */
+struct node *segregatedHole(long size);
+
+/* allocates a given process into a hole found by two-level segregated
+   fit, returning -1 if none is large enough */
+int tlsfFit(struct node *p);
+
+/* places a process in the table engine by a strategy flag, handing its
+   node back to the pool once placed- returns -1 if no hole is large enough */
+int tableFit(struct node *p, char flag);
+
+/* turns the process carrying a name of the current arena into a hole,
+   returning its bytes */
+long releaseInTable(struct name *entry);
+
+/* the table engine's makeProcessHole / resizeNamed */
+int tableRelease(char *name);
+int tableResize(char *name, long size, char flag);
+
+/* places processes, largest first, in one walk of the current arena's
+   table in address order- from the rover for next fit, wrapping around
+   once- as walkBatch does for the list. Marks each one placed, leaving
+   it to be returned to the pool */
+void walkTable(struct node **processes, bool *placed, int count, char flag);
+
+/* the table engine's compactArena / compactUntil, returning the bytes moved */
+long tableCompact();
+long tableCompactUntil(long size);
+
+/* returns the size of the largest hole in the current arena's table */
+long tableLargest();
+
+/* prints every segment of the current arena's table overlapping a range
+   of its addresses, one line of STAT each */
+void printTable(long first, long last);
+
+/* frees the current arena's table */
+void freeTable();
+
+/* writes every arena's segments and names to a file
+   ("SNAPSHOT file") */
+int writeSnapshot(struct command *c);
+
+/* maps a file written by SNAPSHOT and rebuilds memory from it, which
+   must be empty and of the same size, arenas and engine */
+int restoreSnapshot(char *path);
+
+/* unmaps the restored snapshot, once nothing uses its names */
+void unmapSnapshot();
+
+/* converts a text trace into a binary one, giving every process name
+   an id */
+int convertTrace(char *from, char *to);
+
+/* returns true if a trace file is binary, leaving it at its start */
+bool isBinaryTrace(FILE *in);
+
+/* maps a binary trace and replays every record, on as many workers as
+   there are */
+int replayBinary(FILE *in);
+
+/* the scans the table engine runs over a chunk's hole sizes, in a
+   vectorized form where the processor has one */
+typedef struct kernels {
+    const char *name; /* the instruction set they use */
+    /* returns the index of the first hole of at least size bytes, -1 if none */
+    int (*firstFitting)(const long *holes, int count, long size);
+    /* returns the index of the first of the smallest such holes, -1 if none */
+    int (*smallestFitting)(const long *holes, int count, long size);
+    /* returns the size of the largest hole, 0 if there are none */
+    long (*largest)(const long *holes, int count);
+} kernels;
+
+extern struct kernels scan; /* the kernels in use, scalar until chosen */
+
+/* picks the fastest kernels the processor supports, or those named
+   ("avx2", "sse4.2" or "scalar"), returning -1 if it cannot run them */
+int chooseKernels(const char *name);
+
+typedef enum timed {
+    TIMED_FIRST, /* RQ with each strategy flag, in the order F, B, W, N, T */
+    TIMED_BEST,
+    TIMED_WORST,
+    TIMED_NEXT,
+    TIMED_TLSF,
+    TIMED_RELEASE, /* RL */
+    TIMED_RESIZE, /* RS */
+    TIMED_COMPACT, /* C */
+    TIMED_BATCH_REQUEST, /* RQB */
+    TIMED_BATCH_RELEASE, /* RLB */
+    TIMED_KINDS /* number of latency histograms */
+} timed;
+
+/* returns the monotonic clock in nanoseconds */
+long latencyClock();
+
+/* returns the histogram of requests using a strategy flag */
+enum timed timedRequest(char flag);
+
+/* counts how long a command took in its histogram */
+void recordLatency(enum timed kind, long nanoseconds);
+
+/* prints the percentiles of every histogram and empties them ("LATENCY") */
+void printLatency();
+
+typedef enum happening {
+    HAPPENED_REQUEST, /* a process placed (RQ), at its address */
+    HAPPENED_RELEASE, /* a process released (RL), at its address */
+    HAPPENED_SPLIT, /* a hole split for a process, at the hole's old start,
+                       with the bytes taken and the bytes left */
+    HAPPENED_COALESCE, /* holes merged, at the merged hole with its size and
+                          the number of segments merged */
+    HAPPENED_MOVE, /* a process moved by compaction, at its new address,
+                      with its size and old address */
+    HAPPENED_RESIZE, /* a process moved to be resized (RS), at its new
+                        address, with its new size and old address */
+    HAPPENINGS /* number of kinds of event */
+} happening;
+
+extern bool tracing; /* whether events are being recorded */
+extern long eventCapacity; /* events the buffer holds, later ones are dropped */
+
+/* starts recording events, to be written to a file at exit as Chrome
+   trace JSON if its name ends in .json and in binary otherwise */
+int startEvents(char *path);
+
+/* records an event in the current arena, at an address counted from the
+   arena's base */
+void recordEvent(enum happening kind, long address, long size, long other);
+
+/* writes the recorded events out, sorted by time */
+void writeEvents();
+
+/* a trace read into memory, kept private to trace.c */
+struct trace;
+
+/* reads a text or binary trace into memory, NULL if it is damaged */
+struct trace *loadTrace(FILE *in);
+
+/* returns the number of commands in a loaded trace */
+long traceLength(struct trace *t);
+
+/* replays a loaded trace into the calling thread's memory. Given a
+   strategy every request uses it and nothing is printed; given peak the
+   worst external fragmentation seen after any command is kept there */
+void replayTrace(struct trace *t, char strategy, double *peak);
+
+/* frees a loaded trace */
+void freeTrace(struct trace *t);
+
+/* replays a trace against one allocator per strategy and memory size,
+   running threads of them at a time, and prints a table comparing them */
+int compareStrategies(FILE *in, char *strategies, long *sizes, int sizeCount, int count, int threads);
+
+/* returns the name of a strategy flag ("first" for F), or NULL if it is
+   not one */
+const char *strategyName(char flag);
+
+/* reads input a buffer at a time and hands it out a line at a time,
+   kept private to parse.c */
+struct reader;
+
+/* starts reading a stream from where it stands */
+struct reader *openReader(FILE *in);
+
+/* returns the next line, without its newline, in the reader's buffer
+   (and only good until the next call), NULL at the end of the input */
+char *readLine(struct reader *r);
+
+/* frees a reader */
+void closeReader(struct reader *r);
+
+/* reads the rest of a stream into one null terminated buffer, to be
+   freed by the caller, putting its length in length */
+char *readInput(FILE *in, long *length);
+
+/* returns the line starting at *at in text ending at end, cutting it
+   off at its newline and moving *at past it- NULL once at end */
+char *nextLine(char **at, char *end);
+
+/* splits a line into words in place, at spaces and tabs */
+void splitCommand(char *line, struct command *c);
+
+/* returns the word after a word of a split line, which reaches the words
+   past the ones a command keeps- only while count says there is one */
+char *nextWord(char *word);
+
+/* returns true if a command's first word is word */
+bool isCommand(struct command *c, const char *word);
+
+/* returns true if a command quits ("X" or "q") */
+bool isQuit(struct command *c);
+
+/* reads a word that is a number and nothing else / a single strategy
+   letter, returning false if it is not one */
+bool parseNumber(char *word, long *value);
+bool parseStrategy(char *word, char *flag);
+
+/* prints a per-operation message, unless running in batch mode */
+void report(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/* printing for error handling */
+void printRequestError();
+void printReleaseError(int howMany);
+void noMemoryLeft(char *name);
+
+#endif
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "allocator.h"
+
+__thread struct arena *arenas = NULL; /* the arenas memory is split into */
+__thread int arenaCount = 0; /* number of arenas */
+int workers = 1; /* threads replaying a trace, 1 unless running threaded */
+enum routing policy = BYNAME; /* which arena a process tries first */
+
+__thread struct arena *current = NULL; /* the arena the calling thread works in */
+__thread int worker = 0; /* index of the calling worker thread */
+
+void setupArenas(int count) {
+
+    arenas = (struct arena *) calloc(count, sizeof(struct arena));
+    arenaCount = count;
+
+    /* the last arena takes whatever does not divide evenly */
+    int i;
+    for (i = 0; i < count; i++) {
+        struct arena *a = &arenas[i];
+        a->base = i * (bytes / count);
+        a->bytes = i == count - 1 ? bytes - a->base : bytes / count;
+        a->holes.compare = compareHoles;
+        a->segments.compare = compareSegments;
+        a->compactedFrom = -1;
+        a->table.rover = -1;
+        pthread_mutex_init(&a->lock, NULL);
+    }
+
+    current = &arenas[0];
+}
+
+void freeArenas() {
+
+    int i;
+    for (i = 0; i < arenaCount; i++) {
+        current = &arenas[i];
+        freeNames();
+        freeLinkedList();
+        freeNodePool();
+        pthread_mutex_destroy(&arenas[i].lock);
+    }
+
+    unmapBacking();
+    free(arenas);
+    arenas = NULL;
+    arenaCount = 0;
+    current = NULL;
+}
+
+void saveInstance(struct instance *i) {
+
+    i->bytes = bytes;
+    i->arenas = arenas;
+    i->arenaCount = arenaCount;
+}
+
+void useInstance(struct instance *i) {
+
+    bytes = i->bytes;
+    arenas = i->arenas;
+    arenaCount = i->arenaCount;
+    current = &arenas[0];
+}
+
+void lockArena(struct arena *a) {
+
+    if (workers > 1) {
+        pthread_mutex_lock(&a->lock);
+    }
+}
+
+void unlockArena(struct arena *a) {
+
+    if (workers > 1) {
+        pthread_mutex_unlock(&a->lock);
+    }
+}
+
+int homeArena(char *name) {
+
+    if (arenaCount == 1) {
+        return 0;
+    } else if (policy == BYTHREAD) {
+        return worker % arenaCount;
+    }
+
+    /* the high bits of the hash, since the low ones pick the name's
+       slot inside the arena */
+    return (int) (((unsigned long long) hashName(name) * arenaCount) >> 32);
+}
+
+bool arenaEmpty() {
+
+    return mode == TABLE ? current->table.count == 0 : !current->head;
+}
+
+struct arena *arenaOf(long address) {
+
+    long i = address / (bytes / arenaCount);
+    return &arenas[i < arenaCount ? i : arenaCount - 1];
+}
+
+void addTotals(struct summary *into, struct summary *from) {
+
+    into->commands += from->commands;
+    into->placed += from->placed;
+    into->failed += from->failed;
+    into->released += from->released;
+    into->compactions += from->compactions;
+    into->moved += from->moved;
+    into->errors += from->errors;
+
+    int t;
+    for (t = 0; t < TRIGGERS; t++) {
+        into->triggered[t] += from->triggered[t];
+        into->triggeredMoved[t] += from->triggeredMoved[t];
+        into->rescued[t] += from->rescued[t];
+    }
+
+    into->copied += from->copied;
+    into->remapped += from->remapped;
+    into->copyTime += from->copyTime;
+    into->corrupted += from->corrupted;
+    into->resized += from->resized;
+    into->relocated += from->relocated;
+    into->resizeFailed += from->resizeFailed;
+}
@@ -0,0 +1,243 @@
+#include "avl.h"
+
+static int height(struct avlnode *n) {
+
+    return n ? n->height : 0;
+}
+
+static void updateHeight(struct avlnode *n) {
+
+    int l = height(n->left);
+    int r = height(n->right);
+    n->height = (l > r ? l : r) + 1;
+}
+
+/* points whichever link referred to old (a child of parent, or the
+   root) at new instead */
+static void replaceChild(struct avltree *t, struct avlnode *parent, struct avlnode *old, struct avlnode *new) {
+
+    if (!parent) {
+        t->root = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+
+    if (new) {
+        new->parent = parent;
+    }
+}
+
+static struct avlnode *rotateLeft(struct avltree *t, struct avlnode *x) {
+
+    struct avlnode *y = x->right;
+
+    replaceChild(t, x->parent, x, y);
+    x->right = y->left;
+    if (y->left) {
+        y->left->parent = x;
+    }
+    y->left = x;
+    x->parent = y;
+
+    updateHeight(x);
+    updateHeight(y);
+    return y;
+}
+
+static struct avlnode *rotateRight(struct avltree *t, struct avlnode *x) {
+
+    struct avlnode *y = x->left;
+
+    replaceChild(t, x->parent, x, y);
+    x->left = y->right;
+    if (y->right) {
+        y->right->parent = x;
+    }
+    y->right = x;
+    x->parent = y;
+
+    updateHeight(x);
+    updateHeight(y);
+    return y;
+}
+
+/* restores the height invariant from n up to the root */
+static void rebalance(struct avltree *t, struct avlnode *n) {
+
+    while (n) {
+        updateHeight(n);
+        int balance = height(n->left) - height(n->right);
+
+        if (balance > 1) {
+            if (height(n->left->left) < height(n->left->right)) {
+                rotateLeft(t, n->left);
+            }
+            n = rotateRight(t, n);
+        } else if (balance < -1) {
+            if (height(n->right->right) < height(n->right->left)) {
+                rotateRight(t, n->right);
+            }
+            n = rotateLeft(t, n);
+        }
+
+        n = n->parent;
+    }
+}
+
+void avlInsert(struct avltree *t, struct avlnode *n) {
+
+    struct avlnode *parent = NULL;
+    struct avlnode **link = &t->root;
+
+    while (*link) {
+        parent = *link;
+        if (t->compare(n, parent) < 0) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+        }
+    }
+
+    n->left = NULL;
+    n->right = NULL;
+    n->parent = parent;
+    n->height = 1;
+    *link = n;
+
+    rebalance(t, parent);
+}
+
+void avlRemove(struct avltree *t, struct avlnode *n) {
+
+    struct avlnode *start;
+
+    if (n->left && n->right) {
+        /* swap in the in-order successor, which has no left child */
+        struct avlnode *s = n->right;
+        while (s->left) {
+            s = s->left;
+        }
+
+        if (s->parent == n) {
+            start = s;
+        } else {
+            start = s->parent;
+            replaceChild(t, s->parent, s, s->right);
+            s->right = n->right;
+            s->right->parent = s;
+        }
+
+        replaceChild(t, n->parent, n, s);
+        s->left = n->left;
+        s->left->parent = s;
+    } else {
+        start = n->parent;
+        replaceChild(t, n->parent, n, n->left ? n->left : n->right);
+    }
+
+    rebalance(t, start);
+}
+
+struct avlnode *avlFirst(struct avltree *t) {
+
+    struct avlnode *n = t->root;
+    while (n && n->left) {
+        n = n->left;
+    }
+    return n;
+}
+
+struct avlnode *avlLast(struct avltree *t) {
+
+    struct avlnode *n = t->root;
+    while (n && n->right) {
+        n = n->right;
+    }
+    return n;
+}
+
+struct avlnode *avlNext(struct avlnode *n) {
+
+    if (n->right) {
+        n = n->right;
+        while (n->left) {
+            n = n->left;
+        }
+        return n;
+    }
+
+    while (n->parent && n->parent->right == n) {
+        n = n->parent;
+    }
+    return n->parent;
+}
+
+struct avlnode *avlPrev(struct avlnode *n) {
+
+    if (n->left) {
+        n = n->left;
+        while (n->right) {
+            n = n->right;
+        }
+        return n;
+    }
+
+    while (n->parent && n->parent->left == n) {
+        n = n->parent;
+    }
+    return n->parent;
+}
+
+struct avlnode *avlLowerBound(struct avltree *t, const struct avlnode *probe) {
+
+    struct avlnode *n = t->root;
+    struct avlnode *found = NULL;
+
+    while (n) {
+        if (t->compare(n, probe) >= 0) {
+            found = n;
+            n = n->left;
+        } else {
+            n = n->right;
+        }
+    }
+
+    return found;
+}
+
+/* links nodes [low, high) into a balanced subtree and returns its root */
+static struct avlnode *buildRange(char *first, size_t stride, long low, long high, struct avlnode *parent) {
+
+    if (low >= high) {
+        return NULL;
+    }
+
+    long middle = low + (high - low) / 2;
+    struct avlnode *n = (struct avlnode *) (first + middle * stride);
+    n->parent = parent;
+    n->left = buildRange(first, stride, low, middle, n);
+    n->right = buildRange(first, stride, middle + 1, high, n);
+    updateHeight(n);
+    return n;
+}
+
+void avlBuild(struct avltree *t, struct avlnode *first, size_t stride, long count) {
+
+    /* halving the range at every level leaves the two subtrees of any
+       node within one of each other in height */
+    t->root = buildRange((char *) first, stride, 0, count, NULL);
+}
+
+void avlReplace(struct avltree *t, struct avlnode *old, struct avlnode *new) {
+
+    *new = *old;
+    replaceChild(t, old->parent, old, new);
+    if (new->left) {
+        new->left->parent = new;
+    }
+    if (new->right) {
+        new->right->parent = new;
+    }
+}
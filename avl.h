@@ -0,0 +1,48 @@
+#ifndef AVL_H
+#define AVL_H
+
+#include <stddef.h>
+
+/* returns the structure containing the given embedded member */
+#define containerOf(ptr, type, member) \
+    ((type *) ((char *) (ptr) - offsetof(type, member)))
+
+typedef struct avlnode {
+    struct avlnode *left; /* subtree of smaller keys */
+    struct avlnode *right; /* subtree of larger (or equal) keys */
+    struct avlnode *parent; /* parent in the tree, NULL for the root */
+    int height; /* height of the subtree rooted here (leaf = 1) */
+} avlnode;
+
+typedef struct avltree {
+    struct avlnode *root; /* root of the tree, NULL when empty */
+    int (*compare)(const struct avlnode *a, const struct avlnode *b); /* orders two nodes */
+} avltree;
+
+/* inserts a node into the tree, rebalancing on the way back up */
+void avlInsert(struct avltree *t, struct avlnode *n);
+
+/* removes a node that is currently in the tree */
+void avlRemove(struct avltree *t, struct avlnode *n);
+
+/* returns the smallest/largest node in the tree, NULL if empty */
+struct avlnode *avlFirst(struct avltree *t);
+struct avlnode *avlLast(struct avltree *t);
+
+/* returns the in-order successor/predecessor of a node, NULL at the ends */
+struct avlnode *avlNext(struct avlnode *n);
+struct avlnode *avlPrev(struct avlnode *n);
+
+/* returns the first node that does not compare less than the probe,
+   NULL if every node in the tree is smaller */
+struct avlnode *avlLowerBound(struct avltree *t, const struct avlnode *probe);
+
+/* fills an empty tree with count nodes that are already in order, the
+   i-th one stride bytes after the one before, in linear time */
+void avlBuild(struct avltree *t, struct avlnode *first, size_t stride, long count);
+
+/* puts new in the place of old, which must sort the same way, without
+   rebalancing- old is no longer in the tree afterwards */
+void avlReplace(struct avltree *t, struct avlnode *old, struct avlnode *new);
+
+#endif
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE /* for mremap */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "allocator.h"
+
+bool backed = false; /* whether processes have real memory behind them */
+
+/* The pattern of a process is a run of 8-byte words, the first derived
+   from the hash of its name and each one more than the last, so a
+   process that lands on another's bytes or on stale ones is caught */
+
+unsigned long patternSeed(struct node *p) {
+
+    return hashName(p->name) * 0x9E3779B97F4A7C15UL;
+}
+
+/* writes a process's pattern from an offset into it to its end */
+void fillFrom(struct node *p, long offset) {
+
+    char *at = current->data + p->start;
+    unsigned long word = patternSeed(p) + offset / 8;
+
+    long i;
+    for (i = offset / 8 * 8; i + 8 <= p->size; i += 8, word++) {
+        memcpy(at + i, &word, 8);
+    }
+    memcpy(at + i, &word, p->size - i);
+}
+
+void fillData(struct node *p) {
+
+    fillFrom(p, 0);
+}
+
+bool checkData(struct node *p) {
+
+    char *at = current->data + p->start;
+    unsigned long word = patternSeed(p);
+
+    long i;
+    for (i = 0; i + 8 <= p->size; i += 8, word++) {
+        if (memcmp(at + i, &word, 8) != 0) {
+            return false;
+        }
+    }
+    return memcmp(at + i, &word, p->size - i) == 0;
+}
+
+int mapBacking() {
+
+    if (!backed) {
+        return 0;
+    }
+
+    /* pages are only taken as processes are written */
+    char *data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED) {
+        printf(RED "\nCould not map %ld bytes of backing memory.\n\n" END, bytes);
+        return -1;
+    }
+
+    int i;
+    for (i = 0; i < arenaCount; i++) {
+        arenas[i].data = data + arenas[i].base;
+    }
+    return 0;
+}
+
+void unmapBacking() {
+
+    if (arenaCount > 0 && arenas[0].data) {
+        munmap(arenas[0].data, bytes);
+    }
+}
+
+long elapsedSince(struct timespec *begin) {
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin->tv_sec) * 1000000000L + (end.tv_nsec - begin->tv_nsec);
+}
+
+/* hands the whole pages of a move to their new address instead of
+   copying them- returns the bytes remapped, 0 if it could not */
+long remapPages(char *from, char *to, long size) {
+
+    long page = sysconf(_SC_PAGESIZE);
+    long length = size / page * page;
+
+    /* both ends must be page aligned, and the pages must not overlap */
+    if (length < REMAP_PAGES * page || ((unsigned long) from | (unsigned long) to) % page != 0 ||
+        from - to < length) {
+        return 0;
+    }
+
+    if (mremap(from, length, length, MREMAP_MAYMOVE | MREMAP_FIXED, to) == MAP_FAILED) {
+        return 0; /* say the range spans several mappings */
+    }
+
+    /* the pages left behind are unmapped, so map fresh ones there */
+    if (mmap(from, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+             -1, 0) == MAP_FAILED) {
+        printf(RED "\nCould not map backing memory back in.\n\n" END);
+        exit(-1);
+    }
+    return length;
+}
+
+void moveData(struct node *p, long from) {
+
+    char *source = current->data + from;
+    char *target = current->data + p->start;
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    long remapped = target < source ? remapPages(source, target, p->size) : 0;
+    memmove(target + remapped, source + remapped, p->size - remapped);
+
+    totals.copyTime += elapsedSince(&begin);
+    totals.remapped += remapped;
+    totals.copied += p->size - remapped;
+
+    if (!checkData(p)) {
+        totals.corrupted++;
+        report(RED "\nProcess %s did not survive being moved from %ld to %ld.\n\n" END, p->name,
+               current->base + from, current->base + p->start);
+    }
+}
+
+void resizeData(struct node *p, long from, long oldSize) {
+
+    if (p->start == from) {
+        fillFrom(p, oldSize);
+        return;
+    }
+
+    /* the new place already holds the pattern, so copying the old bytes
+       over it shows whether they arrived */
+    long size = oldSize < p->size ? oldSize : p->size;
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    memmove(current->data + p->start, current->data + from, size);
+    totals.copyTime += elapsedSince(&begin);
+    totals.copied += size;
+
+    if (!checkData(p)) {
+        totals.corrupted++;
+        report(RED "\nProcess %s did not survive being moved from %ld to %ld.\n\n" END, p->name,
+               current->base + from, current->base + p->start);
+    }
+}
+
+void moveBlocks(struct node **blocks, long *from, int count) {
+
+    /* blocks may move onto each other in any order, so the ones that
+       move are copied out first and then copied into place */
+    long staged = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (blocks[i]->start != from[i]) {
+            staged += blocks[i]->size;
+        }
+    }
+    if (staged == 0) {
+        return;
+    }
+
+    char *scratch = (char *) malloc(staged);
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    char *at = scratch;
+    for (i = 0; i < count; i++) {
+        if (blocks[i]->start != from[i]) {
+            memcpy(at, current->data + from[i], blocks[i]->size);
+            at += blocks[i]->size;
+        }
+    }
+    at = scratch;
+    for (i = 0; i < count; i++) {
+        if (blocks[i]->start != from[i]) {
+            memcpy(current->data + blocks[i]->start, at, blocks[i]->size);
+            at += blocks[i]->size;
+        }
+    }
+
+    totals.copyTime += elapsedSince(&begin);
+    totals.copied += staged;
+    free(scratch);
+
+    for (i = 0; i < count; i++) {
+        if (blocks[i]->start != from[i] && !checkData(blocks[i])) {
+            totals.corrupted++;
+            report(RED "\nBlock %s did not survive being moved from %ld to %ld.\n\n" END, blocks[i]->name,
+                   current->base + from[i], current->base + blocks[i]->start);
+        }
+    }
+}
+
+void printBacking(struct summary *s) {
+
+    double seconds = s->copyTime / 1e9;
+    long total = s->copied + s->remapped;
+    printf("Backing memory: %ld bytes copied, %ld remapped in %.3f seconds (%.0f MiB/s), "
+           "%ld processes corrupted\n", s->copied, s->remapped, seconds,
+           seconds > 0 ? total / seconds / 1048576 : 0.0, s->corrupted);
+}
@@ -0,0 +1,616 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "allocator.h"
+
+/* RQB places a whole list of processes and RLB releases one. A batch is
+   sorted first- requests by arena and then largest first, releases by
+   address- so the list engine places it in one walk of the segments and
+   merges what it frees in one pass, and it reports once when it is done */
+
+/* one process of an RQB */
+typedef struct batchRequest {
+    char *name; /* name of the process */
+    long size; /* bytes requested */
+    int home; /* arena the process tries first */
+    int index; /* place in the command, to keep equal sizes in order */
+    bool taken; /* whether the name is already in use */
+    bool homeless; /* whether the home arena had no room for it */
+    struct node *p; /* the process node, while it is being placed */
+} batchRequest;
+
+/* what a batch did, for its one message */
+typedef struct batchResult {
+    int placed; /* processes placed or released */
+    int failed; /* processes without room */
+    int taken; /* names already in use, or processes already released */
+    int missing; /* names not in memory */
+    long bytes; /* bytes placed or released */
+} batchResult;
+
+int compareRequests(const void *a, const void *b) {
+
+    const struct batchRequest *x = (const struct batchRequest *) a;
+    const struct batchRequest *y = (const struct batchRequest *) b;
+
+    if (x->home != y->home) {
+        return x->home < y->home ? -1 : 1;
+    }
+    if (x->size != y->size) {
+        return x->size > y->size ? -1 : 1;
+    }
+    return x->index - y->index;
+}
+
+/* counts a process the walk has created */
+void batchCounted(struct batchRequest *r, struct batchResult *result) {
+
+    if (current->compactedFrom >= 0 && r->size > current->compactedFrom) {
+        totals.rescued[current->compactedBy]++;
+        current->compactedFrom = -1;
+    }
+    r->p = NULL;
+    result->placed++;
+    result->bytes += r->size;
+}
+
+/* counts a process placed by the walk, as requestInArena would */
+void batchPlaced(struct batchRequest *r, char flag, struct batchResult *result) {
+
+    r->p->strategy = flag;
+    processCreated(r->p);
+    batchCounted(r, result);
+}
+
+/* places an arena's share of a batch, largest first, in one walk of its
+   segments in address order- from the rover for next fit, wrapping
+   around once. Requests that do not fit keep their node */
+void walkBatch(struct batchRequest *group, int count, char flag, struct batchResult *result) {
+
+    int first = 0; /* the largest request not yet placed */
+    int last = count - 1; /* the smallest */
+    while (first <= last && !group[first].p) {
+        first++;
+    }
+    while (last >= first && !group[last].p) {
+        last--;
+    }
+    if (first > last) {
+        return;
+    }
+
+    if (!current->head) {
+        int i;
+        for (i = first; i <= last && (!group[i].p || group[i].size > current->bytes); i++) {
+        }
+        if (i > last || allocateIntoEmptyMemory(group[i].p) < 0) {
+            return;
+        }
+        if (flag == 'N') {
+            current->rover = group[i].p;
+        }
+        batchPlaced(&group[i], flag, result);
+    }
+
+    struct node *n = flag == 'N' && current->rover ? current->rover : current->tail;
+    long from = n->start; /* where the walk stops once it wraps */
+    bool wrapped = false;
+
+    while (n && first <= last) {
+        /* holes smaller than every request left are passed over at once */
+        if (n->hole && n->size >= group[last].size) {
+            int i;
+            for (i = first; i <= last && n->hole; i++) {
+                struct node *p = group[i].p;
+                if (!p || p->size > n->size) {
+                    continue;
+                }
+                struct node *hole = n;
+                if (hole->size == p->size) {
+                    n = p; /* the hole is used up */
+                }
+                allocateProcessIntoHole(hole, p);
+                if (flag == 'N') {
+                    current->rover = p;
+                }
+                batchPlaced(&group[i], flag, result);
+            }
+            while (first <= last && !group[first].p) {
+                first++;
+            }
+            while (last >= first && !group[last].p) {
+                last--;
+            }
+        }
+
+        n = n->prev;
+        if (!n && flag == 'N' && !wrapped) {
+            n = current->tail;
+            wrapped = true;
+        }
+        if (wrapped && n && n->start >= from) {
+            break;
+        }
+    }
+}
+
+/* walkBatch for the table engine, which walks its own segments and keeps
+   no nodes */
+void walkTableBatch(struct batchRequest *group, int count, char flag, struct batchResult *result) {
+
+    struct node **processes = (struct node **) malloc(sizeof(struct node *) * count);
+    bool *placed = (bool *) calloc(count, sizeof(bool));
+    int i;
+    for (i = 0; i < count; i++) {
+        processes[i] = group[i].p;
+    }
+
+    walkTable(processes, placed, count, flag);
+
+    for (i = 0; i < count; i++) {
+        if (placed[i]) {
+            putNode(group[i].p);
+            batchCounted(&group[i], result);
+        }
+    }
+    free(processes);
+    free(placed);
+}
+
+/* tries the arenas after a process's home one in turn, returning -1 if
+   none has room */
+int requestElsewhere(struct batchRequest *r, char flag) {
+
+    int i;
+    for (i = 1; i < arenaCount; i++) {
+        struct arena *a = &arenas[(r->home + i) % arenaCount];
+        lockArena(a);
+        current = a;
+        int result = requestInArena(r->name, r->size, flag);
+        unlockArena(a);
+
+        if (result == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* places the requests of a batch that all go to the current arena first,
+   leaving the ones without room there for the other arenas */
+void placeGroup(struct batchRequest *group, int count, char flag, struct batchResult *result) {
+
+    int i;
+    if ((mode != LIST && mode != TABLE) || (flag != 'F' && flag != 'N')) {
+        /* the other strategies find each hole through the size index */
+        for (i = 0; i < count; i++) {
+            if (group[i].taken || findName(group[i].name)) {
+                group[i].taken = true;
+            } else if (requestInArena(group[i].name, group[i].size, flag) == 0) {
+                result->placed++;
+                result->bytes += group[i].size;
+            } else {
+                group[i].homeless = true;
+            }
+        }
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (group[i].taken || findName(group[i].name)) {
+            group[i].taken = true;
+            group[i].p = NULL;
+        } else {
+            group[i].p = createProcess(addName(group[i].name), group[i].size);
+        }
+    }
+
+    if (mode == TABLE) {
+        walkTableBatch(group, count, flag, result);
+    } else {
+        walkBatch(group, count, flag, result);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!group[i].p) {
+            continue;
+        }
+        /* not placed, so forget the name and node as requestInArena does */
+        negateProcess(group[i].p->name);
+        putNode(group[i].p);
+        group[i].p = NULL;
+        current->compactedFrom = -1;
+
+        /* compacting might still make room here */
+        if (compactOnFailure && requestInArena(group[i].name, group[i].size, flag) == 0) {
+            result->placed++;
+            result->bytes += group[i].size;
+        } else {
+            group[i].homeless = true;
+        }
+    }
+}
+
+void printBatchError() {
+
+    report(RED "\nTo request memory for several processes at once, structure a command as follows:\n" END);
+    report("\nRQB [process name] [number of bytes] [process name] [number of bytes] ... [strategy]\n\n");
+}
+
+int requestBatch(struct command *c) {
+
+    /* RQB, then pairs of names and sizes, then the strategy */
+    if (c->count < 4 || c->count % 2 != 0) {
+        printBatchError();
+        return -1;
+    }
+
+    int pairs = (c->count - 2) / 2;
+    struct batchRequest *requests = (struct batchRequest *) calloc(pairs, sizeof(struct batchRequest));
+    char *word = c->words[1];
+    int i;
+    for (i = 0; i < pairs; i++) {
+        requests[i].name = word;
+        word = nextWord(word);
+        if (!parseNumber(word, &requests[i].size) || requests[i].size <= 0) {
+            report(RED "\nPlease enter a valid positive number of bytes for %s.\n\n" END, requests[i].name);
+            free(requests);
+            return -1;
+        }
+        word = nextWord(word);
+        requests[i].home = homeArena(requests[i].name);
+        requests[i].index = i;
+    }
+
+    char flag;
+    if (!parseStrategy(word, &flag)) {
+        printBatchError();
+        free(requests);
+        return -1;
+    }
+    long started = latencyClock();
+
+    /* names in use anywhere, before any arena takes a new one */
+    int a;
+    for (a = 0; a < arenaCount; a++) {
+        lockArena(&arenas[a]);
+        current = &arenas[a];
+        for (i = 0; i < pairs; i++) {
+            requests[i].taken = requests[i].taken || duplicate(requests[i].name);
+        }
+        unlockArena(&arenas[a]);
+    }
+
+    qsort(requests, pairs, sizeof(struct batchRequest), compareRequests);
+
+    struct batchResult result = { 0 };
+    quiet = true;
+
+    int begin = 0;
+    while (begin < pairs) {
+        int end = begin;
+        while (end < pairs && requests[end].home == requests[begin].home) {
+            end++;
+        }
+
+        struct arena *home = &arenas[requests[begin].home];
+        lockArena(home);
+        current = home;
+        placeGroup(requests + begin, end - begin, flag, &result);
+        unlockArena(home);
+
+        begin = end;
+    }
+
+    /* what the home arenas had no room for */
+    for (i = 0; i < pairs; i++) {
+        if (requests[i].taken) {
+            result.taken++;
+        } else if (!requests[i].homeless) {
+            continue;
+        } else if (requestElsewhere(&requests[i], flag) == 0) {
+            result.placed++;
+            result.bytes += requests[i].size;
+        } else {
+            noMemoryLeft(requests[i].name);
+            result.failed++;
+        }
+    }
+
+    quiet = false;
+    report(GRN "\nPlaced %d of %d processes (%ld bytes)" END, result.placed, pairs, result.bytes);
+    if (result.failed) {
+        report(RED ", %d without room" END, result.failed);
+    }
+    if (result.taken) {
+        report(RED ", %d names already used" END, result.taken);
+    }
+    report(".\n\n");
+
+    free(requests);
+    recordLatency(TIMED_BATCH_REQUEST, latencyClock() - started);
+    return result.taken ? -1 : 0;
+}
+
+/* turns a run of segments of the current arena, from low up to high,
+   each a hole or a process being released, into one hole kept in high */
+void mergeRun(struct node *low, struct node *high) {
+
+    struct node *below = low->next;
+    long start = low->start;
+
+    if (high->hole) {
+        unindexHole(high);
+    }
+
+    int merged = 1;
+    struct node *n = low;
+    while (n != high) {
+        struct node *above = n->prev;
+        merged++;
+        if (n->hole) {
+            unindexHole(n);
+        }
+        unindexSegment(n);
+        if (current->rover == n) {
+            current->rover = high;
+        }
+        unbindName(n);
+        putNode(n);
+        n = above;
+    }
+
+    high->hole = true;
+    high->start = start;
+    high->size = high->end - start + 1;
+    high->next = below;
+    if (below) {
+        below->prev = high;
+    } else {
+        current->tail = high;
+    }
+    indexHole(high);
+    if (tracing && merged > 1) {
+        recordEvent(HAPPENED_COALESCE, high->start, high->size, merged);
+    }
+}
+
+/* releases processes of the current arena, merging every run of them and
+   the holes around them into one hole in a single pass by address */
+void releaseGroup(struct node **nodes, int count, struct batchResult *result) {
+
+    qsort(nodes, count, sizeof(struct node *), compareStarts);
+
+    /* a name given twice, or by a prefix too, is released once */
+    int kept = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (kept == 0 || nodes[kept - 1] != nodes[i]) {
+            nodes[kept++] = nodes[i];
+        }
+    }
+    count = kept;
+
+    for (i = 0; i < count; i++) {
+        result->placed++;
+        result->bytes += nodes[i]->size;
+    }
+
+    if (mode == BUDDY) {
+        /* a block merges with its buddy, not with whatever lies next to it */
+        for (i = 0; i < count; i++) {
+            releaseInArena(nodes[i]);
+        }
+    } else {
+        for (i = 0; i < count; i++) {
+            current->allocated -= nodes[i]->size;
+            totals.released++;
+            if (tracing) {
+                recordEvent(HAPPENED_RELEASE, nodes[i]->start, nodes[i]->size, 0);
+            }
+        }
+
+        i = 0;
+        while (i < count) {
+            struct node *low = nodes[i];
+            struct node *high = nodes[i];
+            i++;
+
+            /* the run goes on up through holes and processes of the
+               batch, and takes in a hole right below it */
+            while (high->prev && (high->prev->hole || (i < count && nodes[i] == high->prev))) {
+                if (!high->prev->hole) {
+                    i++;
+                }
+                high = high->prev;
+            }
+            if (low->next && low->next->hole) {
+                low = low->next;
+            }
+            mergeRun(low, high);
+        }
+    }
+
+    /* the policies look at the arena once, after the whole batch */
+    if (count > 0) {
+        current->releases += count - 1;
+        compactAfterRelease();
+    }
+}
+
+int compareEntries(const void *a, const void *b) {
+
+    long x = (*(struct name * const *) a)->start;
+    long y = (*(struct name * const *) b)->start;
+    return (x > y) - (x < y);
+}
+
+/* releases the processes of the current arena a batch names in the table
+   engine, lowest first. The table merges each hole as it is made, so
+   there is no run to gather */
+void releaseTableGroup(char **words, bool *found, int names, struct batchResult *result) {
+
+    int capacity = 1024;
+    int count = 0;
+    struct name **entries = (struct name **) malloc(sizeof(struct name *) * capacity);
+
+    int i, j;
+    for (i = 0; i < names; i++) {
+        size_t length = strlen(words[i]);
+        bool prefix = length > 0 && words[i][length - 1] == '*';
+        struct name *entry = NULL;
+
+        for (j = 0; j < (prefix ? current->namecap : 1); j++) {
+            if (prefix) {
+                entry = &current->names[j];
+                if (!entry->str || entry->start < 0 || strncmp(entry->str, words[i], length - 1) != 0) {
+                    continue;
+                }
+            } else if (!found[i]) {
+                entry = findName(words[i]);
+                found[i] = entry != NULL;
+                if (!entry) {
+                    continue;
+                }
+                if (entry->start < 0) {
+                    result->taken++;
+                    continue;
+                }
+            } else {
+                continue;
+            }
+
+            if (count == capacity) {
+                capacity *= 2;
+                entries = (struct name **) realloc(entries, sizeof(struct name *) * capacity);
+            }
+            entries[count++] = entry;
+        }
+    }
+
+    /* a name given twice, or by a prefix too, is released once */
+    qsort(entries, count, sizeof(struct name *), compareEntries);
+    int released = 0;
+    for (i = 0; i < count; i++) {
+        if (i == 0 || entries[i] != entries[i - 1]) {
+            result->placed++;
+            result->bytes += releaseInTable(entries[i]);
+            released++;
+        }
+    }
+
+    /* the policies look at the arena once, after the whole batch */
+    if (released > 0) {
+        current->releases += released - 1;
+        compactAfterRelease();
+    }
+    free(entries);
+}
+
+int releaseBatch(struct command *c) {
+
+    /* RLB, then names, any of them a prefix ending in '*' */
+    if (c->count < 2) {
+        report(RED "\nTo release several processes at once, structure a command as follows:\n" END);
+        report("\nRLB [process name or prefix*] [process name or prefix*] ...\n\n");
+        return -1;
+    }
+
+    long started = latencyClock();
+    int names = c->count - 1;
+    char **words = (char **) malloc(sizeof(char *) * names);
+    bool *found = (bool *) calloc(names, sizeof(bool));
+    char *word = c->words[1];
+    int i;
+    for (i = 0; i < names; i++) {
+        words[i] = word;
+        if (i + 1 < names) {
+            word = nextWord(word);
+        }
+    }
+
+    struct batchResult result = { 0 };
+    int capacity = 1024;
+    struct node **nodes = (struct node **) malloc(sizeof(struct node *) * capacity);
+    quiet = true;
+
+    int a;
+    for (a = 0; a < arenaCount; a++) {
+        lockArena(&arenas[a]);
+        current = &arenas[a];
+
+        if (mode == TABLE) {
+            releaseTableGroup(words, found, names, &result);
+            unlockArena(&arenas[a]);
+            continue;
+        }
+
+        int count = 0;
+        for (i = 0; i < names; i++) {
+            size_t length = strlen(words[i]);
+            bool prefix = length > 0 && words[i][length - 1] == '*';
+            int j = 0;
+            struct node *n = NULL;
+
+            while (true) {
+                if (prefix) {
+                    /* every process whose name starts with the prefix */
+                    for (n = NULL; j < current->namecap && !n; j++) {
+                        struct name *entry = &current->names[j];
+                        if (entry->str && entry->node && !entry->node->hole &&
+                            strncmp(entry->str, words[i], length - 1) == 0) {
+                            n = entry->node;
+                        }
+                    }
+                } else if (!found[i]) {
+                    n = locateProcess(words[i]);
+                    found[i] = n != NULL;
+                    if (n && n->hole) {
+                        result.taken++;
+                        n = NULL;
+                    }
+                }
+                if (!n) {
+                    break;
+                }
+
+                if (count == capacity) {
+                    capacity *= 2;
+                    nodes = (struct node **) realloc(nodes, sizeof(struct node *) * capacity);
+                }
+                nodes[count++] = n;
+                if (!prefix) {
+                    break;
+                }
+            }
+        }
+
+        releaseGroup(nodes, count, &result);
+        unlockArena(&arenas[a]);
+    }
+
+    for (i = 0; i < names; i++) {
+        size_t length = strlen(words[i]);
+        if (!found[i] && (length == 0 || words[i][length - 1] != '*')) {
+            result.missing++;
+        }
+    }
+
+    quiet = false;
+    report(PUR "\nReleased %d processes (%ld bytes)" END, result.placed, result.bytes);
+    if (result.taken) {
+        report(YEL ", %d already released" END, result.taken);
+    }
+    if (result.missing) {
+        report(RED ", %d not in memory" END, result.missing);
+    }
+    report(".\n\n");
+
+    free(nodes);
+    free(found);
+    free(words);
+    recordLatency(TIMED_BATCH_RELEASE, latencyClock() - started);
+    return result.missing ? -1 : 0;
+}
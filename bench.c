@@ -0,0 +1,574 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "allocator.h"
+
+#define NAME_LENGTH 16 /* room for "P" followed by any int */
+#define DEFAULT_BYTES 1048576 /* memory size unless -m says otherwise */
+#define SCALE_AVERAGE 64 /* mean process size when growing memory for -g */
+#define SCALE_OPERATIONS 1000 /* requests and releases timed at each size for -g */
+#define SCALE_MISSES 20 /* requests larger than any hole timed at each size */
+
+typedef enum distribution {
+    UNIFORM, /* sizes evenly spread over [1, 2 * average) */
+    LOGNORMAL, /* a long tail of large requests, sigma = 1 */
+    BIMODAL /* mostly small requests with occasional large ones */
+} distribution;
+
+typedef enum pattern {
+    RANDOM, /* release a random live process */
+    FIFO, /* release the oldest live process */
+    LIFO, /* release the newest live process */
+    PHASED /* fill to the target, then release everything */
+} pattern;
+
+typedef struct op {
+    bool request; /* RQ if true, RL if false */
+    int id; /* index into the name table */
+    long size; /* bytes requested (RQ only) */
+} op;
+
+typedef struct workload {
+    distribution sizes; /* how request sizes are drawn */
+    pattern releases; /* which process is released next */
+    double occupancy; /* fraction of memory the workload tries to keep in use */
+    long average; /* mean request size in bytes */
+    int count; /* number of operations */
+    unsigned long long seed; /* seed for the generator */
+    struct op *ops; /* the generated operations */
+    char (*names)[NAME_LENGTH]; /* name of every process, by id */
+} workload;
+
+typedef struct result {
+    double opsPerSecond; /* operations replayed per second */
+    long p50; /* median per-op latency in nanoseconds */
+    long p99; /* 99th percentile per-op latency in nanoseconds */
+    double peakFragmentation; /* worst 1 - largest hole / free bytes seen */
+    double peakInternal; /* worst share of reserved bytes lost to rounding */
+    double failureRate; /* fraction of requests turned away */
+    long compactions; /* compactions run to rescue requests */
+    long moved; /* bytes relocated by those compactions */
+    long rescued; /* requests placed thanks to them */
+} result;
+
+const char *distributionNames[] = { "uniform", "lognormal", "bimodal" };
+const char *patternNames[] = { "random", "fifo", "lifo", "phased" };
+const char *kernelNames[] = { "avx2", "sse4.2", "scalar" };
+
+/* xorshift64* so runs are reproducible on every platform */
+unsigned long long rngState;
+
+unsigned long long nextRandom() {
+
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+/* returns a uniform double in [0, 1) */
+double uniformRandom() {
+
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* draws a request size according to the workload's distribution */
+long drawSize(struct workload *w) {
+
+    double size;
+
+    if (w->sizes == UNIFORM) {
+        size = 1 + uniformRandom() * (2.0 * w->average - 1);
+
+    } else if (w->sizes == LOGNORMAL) {
+        /* Box-Muller; mu chosen so the mean is the average */
+        double u = uniformRandom();
+        double v = uniformRandom();
+        double z = sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+        size = exp(log(w->average) - 0.5 + z);
+
+    } else {
+        /* 90% around a quarter of the average, 10% large enough to
+           keep the overall mean at the average */
+        if (uniformRandom() < 0.9) {
+            size = 1 + uniformRandom() * (w->average / 2.0);
+        } else {
+            size = 1 + uniformRandom() * (w->average * 15.5);
+        }
+    }
+
+    if (size < 1) {
+        size = 1;
+    } else if (size > bytes) {
+        size = bytes;
+    }
+    return (long) size;
+}
+
+/* generates the operations for a workload. The generator tracks the bytes
+   it meant to allocate rather than what a strategy managed to place, so
+   every strategy replays exactly the same sequence */
+void generateWorkload(struct workload *w) {
+
+    rngState = w->seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    w->ops = (struct op *) malloc(sizeof(struct op) * w->count);
+    w->names = malloc(sizeof(*w->names) * w->count);
+
+    int *live = (int *) malloc(sizeof(int) * w->count);
+    long *sizes = (long *) malloc(sizeof(long) * w->count);
+    int first = 0; /* oldest entry of live still in use (FIFO) */
+    int last = 0; /* one past the newest entry of live */
+    long inUse = 0;
+    long target = (long) (w->occupancy * bytes);
+    int ids = 0;
+    bool draining = false;
+
+    int i;
+    for (i = 0; i < w->count; i++) {
+        struct op *o = &w->ops[i];
+        long size = drawSize(w);
+        bool release;
+
+        if (first == last) {
+            release = false;
+            draining = false;
+        } else if (w->releases == PHASED) {
+            if (inUse + size > target) {
+                draining = true;
+            }
+            release = draining;
+        } else if (inUse + size > target) {
+            release = true;
+        } else {
+            /* some churn below the target too, so holes open up
+               throughout memory instead of only at the top */
+            release = uniformRandom() < 0.2;
+        }
+
+        if (release) {
+            int pick;
+            if (w->releases == RANDOM) {
+                pick = first + nextRandom() % (last - first);
+            } else if (w->releases == LIFO || w->releases == PHASED) {
+                pick = last - 1;
+            } else {
+                pick = first;
+            }
+
+            o->request = false;
+            o->id = live[pick];
+            o->size = 0;
+            inUse -= sizes[pick];
+
+            /* keep live[first, last) dense */
+            if (pick == first) {
+                first++;
+            } else {
+                live[pick] = live[last - 1];
+                sizes[pick] = sizes[last - 1];
+                last--;
+            }
+        } else {
+            o->request = true;
+            o->id = ids;
+            o->size = size;
+            snprintf(w->names[ids], NAME_LENGTH, "P%d", ids);
+            ids++;
+
+            live[last] = o->id;
+            sizes[last] = size;
+            last++;
+            inUse += size;
+        }
+    }
+
+    free(live);
+    free(sizes);
+}
+
+long elapsedNanoseconds(struct timespec *begin, struct timespec *end) {
+
+    return (end->tv_sec - begin->tv_sec) * 1000000000L + (end->tv_nsec - begin->tv_nsec);
+}
+
+int compareLongs(const void *a, const void *b) {
+
+    long x = *(const long *) a;
+    long y = *(const long *) b;
+    return (x > y) - (x < y);
+}
+
+/* replays a workload from empty memory with one engine and strategy */
+struct result runWorkload(struct workload *w, enum engine e, char flag) {
+
+    struct result r = { 0 };
+    long *latency = (long *) malloc(sizeof(long) * w->count);
+    long total = 0;
+
+    resetMemory();
+    mode = e;
+
+    int i;
+    for (i = 0; i < w->count; i++) {
+        struct op *o = &w->ops[i];
+        struct timespec begin, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if (o->request) {
+            requestProcess(w->names[o->id], o->size, flag);
+        } else {
+            makeProcessHole(w->names[o->id]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        latency[i] = elapsedNanoseconds(&begin, &end);
+        total += latency[i];
+
+        struct metrics m = { 0 };
+        arenaMetrics(&m);
+        double fragmentation = externalFragmentation(&m);
+        if (fragmentation > r.peakFragmentation) {
+            r.peakFragmentation = fragmentation;
+        }
+
+        if (mode == BUDDY && current->buddies.reserved > 0) {
+            double internal = (double) internalFragmentation() / current->buddies.reserved;
+            if (internal > r.peakInternal) {
+                r.peakInternal = internal;
+            }
+        }
+    }
+
+    qsort(latency, w->count, sizeof(long), compareLongs);
+    r.p50 = latency[w->count / 2];
+    r.p99 = latency[(int) (w->count * 0.99)];
+    r.opsPerSecond = total > 0 ? w->count / (total / 1e9) : 0;
+
+    long requests = totals.placed + totals.failed;
+    r.failureRate = requests > 0 ? (double) totals.failed / requests : 0;
+    r.compactions = totals.compactions;
+    r.moved = totals.moved;
+    for (i = 0; i < TRIGGERS; i++) {
+        r.rescued += totals.rescued[i];
+    }
+
+    free(latency);
+    return r;
+}
+
+/* grows memory to about segments segments, every other one a hole, then
+   times requests and releases in it, requests no hole can take and a
+   compaction, with one engine and strategy */
+void runScale(long segments, enum engine e, char flag) {
+
+    char name[NAME_LENGTH];
+    struct timespec begin, end;
+
+    freeArenas();
+    bytes = segments * SCALE_AVERAGE;
+    setupArenas(1);
+    mode = e;
+    rngState = 0x9E3779B97F4A7C15ULL;
+
+    /* fill memory from the bottom up (next fit always finds the top
+       hole at once), then release every other process */
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    int capacity = (int) segments;
+    int *live = (int *) malloc(sizeof(int) * capacity);
+    int count = 0;
+    int ids = 0;
+    while (true) {
+        snprintf(name, NAME_LENGTH, "P%d", ids);
+        if (requestProcess(name, 1 + nextRandom() % (2 * SCALE_AVERAGE - 1), 'N') != 0) {
+            break;
+        }
+        ids++;
+    }
+    int i;
+    for (i = 0; i < ids; i++) {
+        snprintf(name, NAME_LENGTH, "P%d", i);
+        if (i % 2 == 0) {
+            makeProcessHole(name);
+        } else {
+            live[count++] = i;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long build = elapsedNanoseconds(&begin, &end);
+
+    /* churn: a request, then the release of a random live process */
+    long requested = 0;
+    long released = 0;
+    for (i = 0; i < SCALE_OPERATIONS; i++) {
+        snprintf(name, NAME_LENGTH, "P%d", ids);
+        long size = 1 + nextRandom() % (2 * SCALE_AVERAGE - 1);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        int placed = requestProcess(name, size, flag);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        requested += elapsedNanoseconds(&begin, &end);
+        if (placed == 0 && count < capacity) {
+            live[count++] = ids;
+        }
+        ids++;
+
+        int pick = nextRandom() % count;
+        snprintf(name, NAME_LENGTH, "P%d", live[pick]);
+        live[pick] = live[--count];
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        makeProcessHole(name);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        released += elapsedNanoseconds(&begin, &end);
+    }
+
+    /* first and next fit have to look at every hole to turn these away */
+    long missed = 0;
+    for (i = 0; i < SCALE_MISSES; i++) {
+        snprintf(name, NAME_LENGTH, "M%d", i);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        requestProcess(name, bytes, flag);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        missed += elapsedNanoseconds(&begin, &end);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    compact();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long compacted = elapsedNanoseconds(&begin, &end);
+
+    printf("%-10ld %-7s %-9s %10.1f %10ld %10ld %10ld %10.2f\n", segments, e == TABLE ? "table" : "list",
+           strategyName(flag), build / 1e6, requested / SCALE_OPERATIONS, released / SCALE_OPERATIONS,
+           missed / SCALE_MISSES, compacted / 1e6);
+    fflush(stdout);
+
+    free(live);
+}
+
+/* compares the list and table engines on memory of 10^4 to 10^6 segments */
+void runScales(const char *strategies, bool listEngine, bool tableEngine) {
+
+    printf("\nMemory grown to each number of segments with processes averaging %d bytes,\n", SCALE_AVERAGE);
+    printf("every other one released, then %d requests and releases timed,\n", SCALE_OPERATIONS);
+    printf("the table engine scanning with %s kernels\n\n", scan.name);
+    printf("%-10s %-7s %-9s %10s %10s %10s %10s %10s\n", "segments", "engine", "strategy", "build ms",
+           "RQ ns", "RL ns", "miss ns", "C ms");
+
+    long segments;
+    for (segments = 10000; segments <= 1000000; segments *= 10) {
+        const char *s;
+        for (s = strategies; *s; s++) {
+            if (!strategyName(*s)) {
+                continue;
+            }
+            if (listEngine) {
+                runScale(segments, LIST, *s);
+            }
+            /* the table has no size classes and uses best fit for T */
+            if (tableEngine && *s != 'T') {
+                runScale(segments, TABLE, *s);
+            }
+        }
+    }
+    printf("\n");
+}
+
+void printUsage() {
+
+    printf("\nUsage: bench [-m bytes] [-n operations] [-s seed] [-a average size]\n");
+    printf("             [-d uniform|lognormal|bimodal|all] [-r random|fifo|lifo|phased]\n");
+    printf("             [-o occupancy] [-f strategies] [-e list|buddy|tlsf|table|all]\n");
+    printf("             [-c] [-l percent] [-i releases] [-g] [-k avx2|sse4.2|scalar]\n");
+    printf("\n-o is the fraction of memory the workload keeps in use (default 0.8),\n");
+    printf("-f lists the strategy flags the list and table engines compare (default FBWNT),\n");
+    printf("-e picks the engines to run (default all) and -c compacts just enough\n");
+    printf("to retry a request that fails while enough bytes are free. -l compacts\n");
+    printf("whenever a release leaves more than that percentage of free bytes\n");
+    printf("outside the largest hole, and -i after every so many releases.\n");
+    printf("\n-g instead grows memory to 10^4, 10^5 and 10^6 segments and times\n");
+    printf("requests, releases, requests too large for any hole and compaction\n");
+    printf("there with the list and table engines. -k picks the kernels the table\n");
+    printf("engine scans hole sizes with (default the fastest the processor has).\n\n");
+}
+
+/* returns the index of name in list, -1 if absent */
+int lookup(const char *name, const char **list, int count) {
+
+    int i;
+    for (i = 0; i < count; i++) {
+        if (strcmp(name, list[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+
+    struct workload w = { LOGNORMAL, RANDOM, 0.8, 1024, 200000, 1, NULL, NULL };
+    const char *strategies = "FBWNT";
+    bool everyDistribution = true;
+    bool listEngine = true;
+    bool buddyEngine = true;
+    bool tlsfEngine = true;
+    bool tableEngine = true;
+    bool scales = false;
+    const char *instructions = NULL; /* kernels to scan with, the fastest supported unless named */
+
+    bytes = DEFAULT_BYTES;
+    batch = true; /* keep per-op messages out of the measurements */
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:n:s:a:d:r:o:f:e:cl:i:gk:")) != -1) {
+        if (opt == 'm') {
+            bytes = strtol(optarg, NULL, 10);
+        } else if (opt == 'n') {
+            w.count = atoi(optarg);
+        } else if (opt == 's') {
+            w.seed = strtoull(optarg, NULL, 10);
+        } else if (opt == 'a') {
+            w.average = strtol(optarg, NULL, 10);
+        } else if (opt == 'd') {
+            everyDistribution = strcmp(optarg, "all") == 0;
+            if (!everyDistribution) {
+                int d = lookup(optarg, distributionNames, 3);
+                if (d < 0) {
+                    printUsage();
+                    return -1;
+                }
+                w.sizes = d;
+            }
+        } else if (opt == 'r') {
+            int r = lookup(optarg, patternNames, 4);
+            if (r < 0) {
+                printUsage();
+                return -1;
+            }
+            w.releases = r;
+        } else if (opt == 'o') {
+            w.occupancy = atof(optarg);
+        } else if (opt == 'f') {
+            strategies = optarg;
+        } else if (opt == 'e') {
+            listEngine = strcmp(optarg, "list") == 0 || strcmp(optarg, "all") == 0;
+            buddyEngine = strcmp(optarg, "buddy") == 0 || strcmp(optarg, "all") == 0;
+            tlsfEngine = strcmp(optarg, "tlsf") == 0 || strcmp(optarg, "all") == 0;
+            tableEngine = strcmp(optarg, "table") == 0 || strcmp(optarg, "all") == 0;
+            if (!listEngine && !buddyEngine && !tlsfEngine && !tableEngine) {
+                printUsage();
+                return -1;
+            }
+        } else if (opt == 'c') {
+            compactOnFailure = true;
+        } else if (opt == 'l') {
+            compactAbove = atof(optarg) / 100;
+        } else if (opt == 'i') {
+            compactEvery = strtol(optarg, NULL, 10);
+        } else if (opt == 'g') {
+            scales = true;
+        } else if (opt == 'k') {
+            if (lookup(optarg, kernelNames, 3) < 0) {
+                printUsage();
+                return -1;
+            }
+            instructions = optarg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if (bytes <= 0 || bytes > MAX || w.count <= 0 || w.average <= 0 || w.occupancy <= 0 || w.occupancy > 1 ||
+        compactAbove < 0 || compactAbove >= 1 || compactEvery < 0) {
+        printUsage();
+        return -1;
+    }
+    if (chooseKernels(instructions) < 0) {
+        printf("This processor cannot run the %s kernels.\n", instructions);
+        return -1;
+    }
+
+    setupArenas(1);
+
+    if (scales) {
+        runScales(strategies, listEngine, tableEngine);
+        freeArenas();
+        return 0;
+    }
+
+    printf("\n%ld bytes, %d operations, seed %llu, average request %ld bytes,\n",
+           bytes, w.count, w.seed, w.average);
+    printf("%s release, %.0f%% target occupancy%s", patternNames[w.releases],
+           w.occupancy * 100, compactOnFailure ? ", compaction on failure" : "");
+    if (compactAbove > 0) {
+        printf(", compaction above %.1f%% fragmentation", compactAbove * 100);
+    }
+    if (compactEvery) {
+        printf(", compaction every %ld releases", compactEvery);
+    }
+    printf("\n\n%-10s %-9s %12s %8s %8s %10s %9s %8s %12s %12s %9s\n", "sizes", "strategy", "ops/sec",
+           "p50 ns", "p99 ns", "peak frag", "int frag", "failed", "compactions", "bytes moved", "rescued");
+
+    int d;
+    for (d = 0; d < 3; d++) {
+        if (!everyDistribution && d != (int) w.sizes) {
+            continue;
+        }
+
+        struct workload run = w;
+        run.sizes = d;
+        generateWorkload(&run);
+
+        const char *s;
+        for (s = listEngine ? strategies : ""; *s; s++) {
+            const char *label = strategyName(*s);
+            if (!label) {
+                printf("Unknown strategy flag %c.\n", *s);
+                continue;
+            }
+
+            struct result r = runWorkload(&run, LIST, *s);
+            printf("%-10s %-9s %12.0f %8ld %8ld %9.1f%% %9s %7.2f%% %12ld %12ld %9ld\n", distributionNames[d], label,
+                   r.opsPerSecond, r.p50, r.p99, r.peakFragmentation * 100, "-",
+                   r.failureRate * 100, r.compactions, r.moved, r.rescued);
+        }
+
+        for (s = tableEngine ? strategies : ""; *s; s++) {
+            if (!strategyName(*s) || *s == 'T') {
+                continue; /* unknown, or T, which the table runs as best fit */
+            }
+            char label[10];
+            snprintf(label, sizeof(label), "table-%c", *s);
+
+            struct result r = runWorkload(&run, TABLE, *s);
+            printf("%-10s %-9s %12.0f %8ld %8ld %9.1f%% %9s %7.2f%% %12ld %12ld %9ld\n", distributionNames[d], label,
+                   r.opsPerSecond, r.p50, r.p99, r.peakFragmentation * 100, "-",
+                   r.failureRate * 100, r.compactions, r.moved, r.rescued);
+        }
+
+        if (buddyEngine) {
+            struct result r = runWorkload(&run, BUDDY, 'F');
+            printf("%-10s %-9s %12.0f %8ld %8ld %9.1f%% %8.1f%% %7.2f%% %12ld %12ld %9ld\n", distributionNames[d], "buddy",
+                   r.opsPerSecond, r.p50, r.p99, r.peakFragmentation * 100, r.peakInternal * 100,
+                   r.failureRate * 100, r.compactions, r.moved, r.rescued);
+        }
+
+        if (tlsfEngine) {
+            struct result r = runWorkload(&run, TLSF, 'T');
+            printf("%-10s %-9s %12.0f %8ld %8ld %9.1f%% %9s %7.2f%% %12ld %12ld %9ld\n", distributionNames[d], "tlsf-only",
+                   r.opsPerSecond, r.p50, r.p99, r.peakFragmentation * 100, "-",
+                   r.failureRate * 100, r.compactions, r.moved, r.rescued);
+        }
+
+        free(run.ops);
+        free(run.names);
+    }
+    printf("\n");
+
+    freeArenas();
+    return 0;
+}
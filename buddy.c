@@ -0,0 +1,448 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "allocator.h"
+
+int blockOrder(long size) {
+
+    return size <= 1 ? 0 : 64 - __builtin_clzl(size - 1);
+}
+
+void pushFreeBlock(struct node *n) {
+
+    int k = n->order;
+
+    n->prevFree = NULL;
+    n->nextFree = current->buddies.free[k];
+    if (current->buddies.free[k]) {
+        current->buddies.free[k]->prevFree = n;
+    }
+    current->buddies.free[k] = n;
+    current->buddies.nonEmpty |= 1UL << k;
+
+    current->freeBytes += 1L << k;
+    current->holeCount++;
+}
+
+void removeFreeBlock(struct node *n) {
+
+    int k = n->order;
+
+    if (n->prevFree) {
+        n->prevFree->nextFree = n->nextFree;
+    } else {
+        current->buddies.free[k] = n->nextFree;
+    }
+    if (n->nextFree) {
+        n->nextFree->prevFree = n->prevFree;
+    }
+
+    if (!current->buddies.free[k]) {
+        current->buddies.nonEmpty &= ~(1UL << k);
+    }
+
+    current->freeBytes -= 1L << k;
+    current->holeCount--;
+}
+
+void addFreeBlocks(long start, long end) {
+
+    /* a block must start at a multiple of its size, so memory that is
+       not a power of two becomes a few top-level blocks, largest first.
+       None of them ever finds a free buddy of its own order */
+    while (start <= end) {
+        int k = 0;
+        while (k + 1 < BUDDY_ORDERS && start % (2L << k) == 0 && (2L << k) <= end - start + 1) {
+            k++;
+        }
+
+        struct node *h = createHole(start, start + (1L << k) - 1);
+        h->order = k;
+        h->next = current->head;
+        if (current->head) {
+            current->head->prev = h;
+        } else {
+            current->tail = h;
+        }
+        current->head = h;
+        pushFreeBlock(h);
+        indexSegment(h);
+
+        start += 1L << k;
+    }
+}
+
+int buddyFit(struct node *p /* a process with only a name and size */) {
+
+    if (!current->head) {
+        addFreeBlocks(0, current->bytes - 1);
+    }
+
+    int k = blockOrder(p->size);
+    if (k >= BUDDY_ORDERS) {
+        return -1;
+    }
+
+    /* the lowest non-empty order at or above k */
+    unsigned long candidates = current->buddies.nonEmpty >> k << k;
+    if (!candidates) {
+        return -1;
+    }
+    int j = __builtin_ctzl(candidates);
+
+    struct node *b = current->buddies.free[j];
+    removeFreeBlock(b);
+
+    /* halve the block until it is the right order, keeping the lower
+       half and freeing the upper one */
+    while (j > k) {
+        j--;
+        struct node *upper = createHole(b->start + (1L << j), b->start + (2L << j) - 1);
+        upper->order = j;
+        upper->next = b;
+        upper->prev = b->prev;
+        if (b->prev) {
+            b->prev->next = upper;
+        } else {
+            current->head = upper;
+        }
+        b->prev = upper;
+        pushFreeBlock(upper);
+        indexSegment(upper);
+
+        b->size = 1L << j;
+        b->end = b->start + b->size - 1;
+        if (tracing) {
+            recordEvent(HAPPENED_SPLIT, b->start, b->size, upper->size);
+        }
+    }
+
+    /* the process takes the block's place in the list */
+    p->start = b->start;
+    p->end = b->end;
+    p->order = k;
+    p->hole = false;
+
+    p->next = b->next;
+    if (b->next) {
+        b->next->prev = p;
+    } else {
+        current->tail = p;
+    }
+    p->prev = b->prev;
+    if (b->prev) {
+        b->prev->next = p;
+    } else {
+        current->head = p;
+    }
+
+    replaceSegment(b, p);
+    unbindName(b);
+    putNode(b);
+    bindName(p);
+
+    current->buddies.reserved += 1L << k;
+    processCreated(p);
+    return 0;
+}
+
+int buddyResize(struct node *n, long size) {
+
+    int k = n->order;
+    int wanted = blockOrder(size);
+    if (wanted >= BUDDY_ORDERS) {
+        return -1;
+    }
+
+    if (wanted > k) {
+        /* the block can only double while it is the lower buddy and its
+           upper buddy is one free block, so check the whole way first */
+        struct node *b = n->prev;
+        int j;
+        for (j = k; j < wanted; j++, b = b->prev) {
+            if (n->start % (2L << j) != 0 || !b || !b->hole || b->order != j ||
+                b->start != n->start + (1L << j)) {
+                return -1;
+            }
+        }
+
+        for (j = k; j < wanted; j++) {
+            b = n->prev;
+            removeFreeBlock(b);
+            unindexSegment(b);
+            unbindName(b);
+            n->prev = b->prev;
+            if (b->prev) {
+                b->prev->next = n;
+            } else {
+                current->head = n;
+            }
+            putNode(b);
+        }
+    } else {
+        /* halve the block, freeing upper halves, as when it was split */
+        int j;
+        for (j = k - 1; j >= wanted; j--) {
+            struct node *upper = createHole(n->start + (1L << j), n->start + (2L << j) - 1);
+            upper->order = j;
+            upper->next = n;
+            upper->prev = n->prev;
+            if (n->prev) {
+                n->prev->next = upper;
+            } else {
+                current->head = upper;
+            }
+            n->prev = upper;
+            pushFreeBlock(upper);
+            indexSegment(upper);
+        }
+    }
+
+    current->buddies.reserved += (1L << wanted) - (1L << k);
+    current->allocated += size - n->size;
+    n->order = wanted;
+    n->size = size;
+    n->end = n->start + (1L << wanted) - 1;
+    return 0;
+}
+
+void buddyRelease(struct node *n) {
+
+    int k = n->order;
+
+    current->buddies.reserved -= 1L << k;
+    n->size = 1L << k;
+
+    /* a block's buddy is its neighbour in the list: the one below if
+       bit k of its address is set, the one above otherwise */
+    while (k + 1 < BUDDY_ORDERS) {
+        struct node *b = (n->start & (1L << k)) ? n->next : n->prev;
+        if (!b || !b->hole || b->order != k || b->start != (n->start ^ (1L << k))) {
+            break;
+        }
+
+        if (debug) {
+            printf(YEL "Merging block %s with its buddy %s\n" END, n->name, b->name);
+        }
+
+        removeFreeBlock(b);
+
+        struct node *lower = b->start < n->start ? b : n;
+        struct node *upper = lower == b ? n : b;
+
+        lower->prev = upper->prev;
+        if (upper->prev) {
+            upper->prev->next = lower;
+        } else {
+            current->head = lower;
+        }
+        lower->order = k + 1;
+        lower->size = 2L << k;
+        lower->end = lower->start + lower->size - 1;
+        if (tracing) {
+            recordEvent(HAPPENED_COALESCE, lower->start, lower->size, 2);
+        }
+
+        unindexSegment(upper);
+        unbindName(upper);
+        putNode(upper);
+
+        n = lower;
+        k++;
+    }
+
+    pushFreeBlock(n);
+}
+
+int compareBlocks(const void *a, const void *b) {
+
+    struct node *x = *(struct node * const *) a;
+    struct node *y = *(struct node * const *) b;
+
+    if (x->order != y->order) {
+        return x->order > y->order ? -1 : 1;
+    }
+    /* the highest block of an order is the likeliest to stay put */
+    return (x->start < y->start) - (x->start > y->start);
+}
+
+int compareStarts(const void *a, const void *b) {
+
+    struct node *x = *(struct node * const *) a;
+    struct node *y = *(struct node * const *) b;
+
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/* returns the largest block addFreeBlocks would make of a range */
+long largestBlock(long start, long end) {
+
+    long largest = 0;
+    while (start <= end) {
+        int k = 0;
+        while (k + 1 < BUDDY_ORDERS && start % (2L << k) == 0 && (2L << k) <= end - start + 1) {
+            k++;
+        }
+        if (1L << k > largest) {
+            largest = 1L << k;
+        }
+        start += 1L << k;
+    }
+    return largest;
+}
+
+long buddyCompact() {
+
+    int count = 0;
+    struct node *n;
+    for (n = current->tail; n != NULL; n = n->prev) {
+        if (!n->hole) {
+            count++;
+        }
+    }
+
+    struct node **blocks = (struct node **) malloc(sizeof(struct node *) * (count + 1));
+    long *to = (long *) malloc(sizeof(long) * (count + 1));
+    int i = 0;
+    for (n = current->tail; n != NULL; n = n->prev) {
+        if (!n->hole) {
+            blocks[i++] = n;
+        }
+    }
+
+    /* every top-level block is a room filled from its top down, largest
+       blocks first, each into the fullest room it still fits in. Each
+       block then lands on a multiple of its own size, and the free bytes
+       gather at the bottom of each room where they form the largest
+       blocks they can */
+    long roomStart[BUDDY_ORDERS];
+    long roomTop[BUDDY_ORDERS];
+    int rooms = 0;
+    int k;
+    long start = 0;
+    for (k = BUDDY_ORDERS - 1; k >= 0; k--) {
+        if (current->bytes & (1L << k)) {
+            roomStart[rooms] = start;
+            roomTop[rooms] = start + (1L << k);
+            start += 1L << k;
+            rooms++;
+        }
+    }
+
+    qsort(blocks, count, sizeof(struct node *), compareBlocks);
+
+    /* a block that fills a room by itself is already where it belongs */
+    int r;
+    for (i = 0; i < count; i++) {
+        to[i] = -1;
+        for (r = 0; r < rooms; r++) {
+            if (blocks[i]->start == roomStart[r] && 1L << blocks[i]->order == roomTop[r] - roomStart[r]) {
+                to[i] = roomStart[r];
+                roomTop[r] = roomStart[r];
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (to[i] >= 0) {
+            continue;
+        }
+        long size = 1L << blocks[i]->order;
+        int best = -1;
+        for (r = 0; r < rooms; r++) {
+            long room = roomTop[r] - roomStart[r];
+            if (room >= size && (best < 0 || room < roomTop[best] - roomStart[best])) {
+                best = r;
+            }
+        }
+        roomTop[best] -= size;
+        to[i] = roomTop[best];
+    }
+
+    /* moving blocks is only worth it if a larger block comes free */
+    long largest = 0;
+    for (r = 0; r < rooms; r++) {
+        long room = largestBlock(roomStart[r], roomTop[r] - 1);
+        if (room > largest) {
+            largest = room;
+        }
+    }
+    if (largest <= largestHole()) {
+        free(blocks);
+        free(to);
+        return 0;
+    }
+
+    /* free blocks are rebuilt from scratch once the processes are packed */
+    n = current->tail;
+    while (n) {
+        struct node *up = n->prev;
+        if (n->hole) {
+            unbindName(n);
+            putNode(n);
+        }
+        n = up;
+    }
+
+    current->head = NULL;
+    current->tail = NULL;
+    current->segments.root = NULL;
+    memset(current->buddies.free, 0, sizeof(current->buddies.free));
+    current->buddies.nonEmpty = 0;
+    current->freeBytes = 0;
+    current->holeCount = 0;
+
+    long *from = current->data ? (long *) malloc(sizeof(long) * (count + 1)) : NULL;
+    long moved = 0;
+    for (i = 0; i < count; i++) {
+        n = blocks[i];
+        if (from) {
+            from[i] = n->start;
+        }
+        if (n->start != to[i]) {
+            moved += n->size;
+            if (tracing) {
+                recordEvent(HAPPENED_MOVE, to[i], n->size, n->start);
+            }
+            n->start = to[i];
+            n->end = n->start + (1L << n->order) - 1;
+        }
+    }
+    free(to);
+
+    if (from) {
+        moveBlocks(blocks, from, count);
+        free(from);
+    }
+
+    /* relink everything in address order */
+    qsort(blocks, count, sizeof(struct node *), compareStarts);
+
+    long cursor = 0;
+    for (i = 0; i < count; i++) {
+        n = blocks[i];
+        addFreeBlocks(cursor, n->start - 1);
+
+        n->prev = NULL;
+        n->next = current->head;
+        if (current->head) {
+            current->head->prev = n;
+        } else {
+            current->tail = n;
+        }
+        current->head = n;
+        indexSegment(n);
+        cursor = n->end + 1;
+    }
+    addFreeBlocks(cursor, current->bytes - 1);
+
+    free(blocks);
+    return moved;
+}
+
+long internalFragmentation() {
+
+    return current->buddies.reserved - current->allocated;
+}
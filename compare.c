@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "allocator.h"
+
+/* one allocator of the comparison and what it did with the trace */
+typedef struct comparison {
+    char strategy; /* flag every request uses */
+    long bytes; /* size of its memory */
+    struct summary totals; /* what it did */
+    double peak; /* worst external fragmentation seen */
+    struct metrics end; /* the counters once the trace is done */
+    double seconds; /* time taken to replay the trace */
+} comparison;
+
+/* the allocators still to run, taken in turn by every thread */
+typedef struct pool {
+    struct trace *trace; /* the trace every allocator replays */
+    struct comparison *runs; /* every allocator */
+    int count; /* number of allocators */
+    int next; /* index of the next allocator to run */
+    int arenas; /* arenas each allocator splits its memory into */
+} pool;
+
+const char *strategyName(char flag) {
+
+    return flag == 'F' ? "first" : flag == 'B' ? "best" : flag == 'W' ? "worst" :
+           flag == 'N' ? "next" : flag == 'T' ? "tlsf" : NULL;
+}
+
+/* sets up memory of its own for one allocator, replays the trace into
+   it and frees it again */
+void runComparison(struct pool *p, struct comparison *c) {
+
+    bytes = c->bytes;
+    setupArenas(p->arenas);
+    memset(&totals, 0, sizeof(totals));
+    if (mapBacking() < 0) {
+        freeArenas();
+        return;
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    replayTrace(p->trace, c->strategy, &c->peak);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    c->seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    c->totals = totals;
+    gatherMetrics(&c->end);
+    freeArenas();
+}
+
+void *runPool(void *arg) {
+
+    struct pool *p = (struct pool *) arg;
+
+    int i;
+    while ((i = __sync_fetch_and_add(&p->next, 1)) < p->count) {
+        runComparison(p, &p->runs[i]);
+    }
+
+    return NULL;
+}
+
+int compareStrategies(FILE *in, char *strategies, long *sizes, int sizeCount, int count, int threads) {
+
+    struct trace *t = loadTrace(in);
+    if (!t) {
+        return -1;
+    }
+
+    struct pool p = { t, NULL, 0, 0, count };
+    int flags = strlen(strategies);
+    p.runs = (struct comparison *) calloc(flags * sizeCount, sizeof(struct comparison));
+
+    int i, j;
+    for (i = 0; i < sizeCount; i++) {
+        for (j = 0; j < flags; j++) {
+            p.runs[p.count].strategy = strategies[j];
+            p.runs[p.count].bytes = sizes[i];
+            p.count++;
+        }
+    }
+
+    if (threads > p.count) {
+        threads = p.count;
+    }
+    pthread_t *pool = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+    for (i = 0; i < threads; i++) {
+        pthread_create(&pool[i], NULL, runPool, &p);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(pool[i], NULL);
+    }
+
+    printf("\nReplayed %ld commands against %d allocator%s on %d thread%s.\n", traceLength(t),
+           p.count, p.count == 1 ? "" : "s", threads, threads == 1 ? "" : "s");
+    if (compactOnFailure) {
+        printf("Compacting on failure.\n");
+    }
+    if (compactAbove > 0) {
+        printf("Compacting above %.1f%% fragmentation.\n", 100 * compactAbove);
+    }
+    if (compactEvery) {
+        printf("Compacting every %ld releases.\n", compactEvery);
+    }
+    printf("\n%-9s %14s %10s %10s %9s %10s %9s %12s %14s %10s %9s", "strategy", "bytes", "placed", "failed",
+           "fail rate", "peak frag", "end frag", "compactions", "bytes moved", "rescued", "seconds");
+    if (backed) {
+        printf(" %9s %9s %9s", "copy ms", "MiB/s", "corrupt");
+    }
+    printf("\n");
+
+    for (i = 0; i < p.count; i++) {
+        struct comparison *c = &p.runs[i];
+        long requests = c->totals.placed + c->totals.failed;
+        long rescued = 0;
+        for (j = 0; j < TRIGGERS; j++) {
+            rescued += c->totals.rescued[j];
+        }
+        printf("%-9s %14ld %10ld %10ld %8.2f%% %9.2f%% %8.2f%% %12ld %14ld %10ld %9.3f", strategyName(c->strategy),
+               c->bytes, c->totals.placed, c->totals.failed,
+               requests ? 100.0 * c->totals.failed / requests : 0.0, 100.0 * c->peak,
+               100.0 * externalFragmentation(&c->end), c->totals.compactions, c->totals.moved, rescued, c->seconds);
+        if (backed) {
+            double copySeconds = c->totals.copyTime / 1e9;
+            printf(" %9.1f %9.0f %9ld", copySeconds * 1000,
+                   copySeconds > 0 ? (c->totals.copied + c->totals.remapped) / copySeconds / 1048576 : 0.0,
+                   c->totals.corrupted);
+        }
+        printf("\n");
+    }
+    printf("\n");
+
+    free(pool);
+    free(p.runs);
+    freeTrace(t);
+    return 0;
+}
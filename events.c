@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "allocator.h"
+
+/* Events go into one buffer allocated up front. A thread takes a block
+   of slots at a time with a single atomic add and fills them in, so
+   workers never wait for each other or share a cache line, and nothing
+   is written to the file until exit. Where
+   the processor has a time stamp counter an event is stamped with it,
+   which costs a few nanoseconds against a few tens for the clock, and
+   the ticks are turned into nanoseconds from two readings of both taken
+   at the start and at the end */
+
+#define EVENT_BLOCK 256 /* slots a thread takes at a time */
+#define EVENT_UNUSED 0xff /* the kind of a slot no event was written to */
+#define EVENT_MAGIC "ALLOCEV1" /* first 8 bytes of a binary event file */
+
+typedef struct event {
+    long time; /* ticks at which it happened */
+    long address; /* lowest address it concerns */
+    long size; /* bytes it concerns */
+    long other; /* what else its kind records, see enum happening */
+    unsigned char kind; /* an enum happening */
+    short worker; /* thread it happened on */
+    int arena; /* arena it happened in */
+} event;
+
+const char *happeningNames[HAPPENINGS] = { "RQ", "RL", "split", "coalesce", "move", "RS" };
+
+bool tracing = false;
+
+struct event *events = NULL;
+long eventCapacity = 1L << 21; /* events kept, later ones are dropped */
+long eventCount = 0; /* slots handed out in blocks, which may run past the buffer */
+long dropped = 0; /* events that found the buffer full */
+__thread long nextSlot = 0; /* next slot of the calling thread's block */
+__thread long blockEnd = 0; /* slot after its block */
+FILE *eventFile = NULL;
+bool eventJson = false; /* Chrome trace JSON rather than binary */
+long startTicks;
+long startClock;
+
+long eventTicks() {
+
+#if defined(__x86_64__) || defined(__i386__)
+    return (long) __builtin_ia32_rdtsc();
+#else
+    return latencyClock();
+#endif
+}
+
+int startEvents(char *path) {
+
+    eventFile = fopen(path, "wb");
+    if (!eventFile) {
+        printf("Could not open %s for events.\n", path);
+        return -1;
+    }
+    const char *dot = strrchr(path, '.');
+    eventJson = dot && strcmp(dot, ".json") == 0;
+
+    /* touched now so that recording never waits on a page fault, and
+       marked so that the ends of blocks left unused can be told apart */
+    events = (struct event *) malloc(sizeof(struct event) * eventCapacity);
+    if (!events) {
+        printf("Could not allocate room for %ld events.\n", eventCapacity);
+        fclose(eventFile);
+        remove(path);
+        return -1;
+    }
+    memset(events, EVENT_UNUSED, sizeof(struct event) * eventCapacity);
+    startClock = latencyClock();
+    startTicks = eventTicks();
+    tracing = true;
+    atexit(writeEvents);
+    return 0;
+}
+
+void recordEvent(enum happening kind, long address, long size, long other) {
+
+    if (nextSlot == blockEnd) {
+        nextSlot = __atomic_fetch_add(&eventCount, EVENT_BLOCK, __ATOMIC_RELAXED);
+        blockEnd = nextSlot + EVENT_BLOCK;
+    }
+    if (nextSlot >= eventCapacity) {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    struct event *e = &events[nextSlot++];
+    e->time = eventTicks();
+    e->address = current->base + address;
+    e->size = size;
+    e->other = other;
+    e->kind = kind;
+    e->worker = worker;
+    e->arena = current - arenas;
+}
+
+/* orders events by the time they happened, since workers take slots out
+   of order with their stamps */
+int compareEvents(const void *a, const void *b) {
+
+    const struct event *x = (const struct event *) a;
+    const struct event *y = (const struct event *) b;
+
+    if (x->time != y->time) {
+        return x->time < y->time ? -1 : 1;
+    }
+    return 0;
+}
+
+void writeEvents() {
+
+    tracing = false;
+    long endClock = latencyClock();
+    long endTicks = eventTicks();
+    double perTick = endTicks > startTicks ? (double) (endClock - startClock) / (endTicks - startTicks) : 1;
+
+    /* packs the events written down over the unused slots, in
+       nanoseconds from the start of the run */
+    long slots = eventCount < eventCapacity ? eventCount : eventCapacity;
+    long count = 0;
+    long i;
+    for (i = 0; i < slots; i++) {
+        if (events[i].kind != EVENT_UNUSED) {
+            events[count] = events[i];
+            events[count].time = (long) ((events[i].time - startTicks) * perTick);
+            count++;
+        }
+    }
+    qsort(events, count, sizeof(struct event), compareEvents);
+
+    if (eventJson) {
+        /* one instant event each, with an arena as a process and a worker
+           as a thread of it */
+        const char *otherNames[HAPPENINGS] = { NULL, NULL, "left", "holes", "from", "from" };
+        int arenasSeen = 0;
+        fprintf(eventFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        for (i = 0; i < count; i++) {
+            struct event *e = &events[i];
+            fprintf(eventFile, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%ld.%03ld,\"pid\":%d,\"tid\":%d,"
+                    "\"args\":{\"address\":%ld,\"size\":%ld", happeningNames[e->kind], e->time / 1000,
+                    e->time % 1000, e->arena, e->worker, e->address, e->size);
+            if (otherNames[e->kind]) {
+                fprintf(eventFile, ",\"%s\":%ld", otherNames[e->kind], e->other);
+            }
+            fprintf(eventFile, "}},\n");
+            if (e->arena >= arenasSeen) {
+                arenasSeen = e->arena + 1;
+            }
+        }
+        int a;
+        for (a = 0; a < arenasSeen; a++) {
+            fprintf(eventFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"arena %d\"}},\n",
+                    a, a);
+        }
+        /* JSON allows no comma after the last event */
+        fprintf(eventFile, "{\"name\":\"end\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%ld.%03ld,\"pid\":0,\"tid\":0}\n]}\n",
+                (endClock - startClock) / 1000, (endClock - startClock) % 1000);
+    } else {
+        fwrite(EVENT_MAGIC, 1, 8, eventFile);
+        fwrite(&count, sizeof(long), 1, eventFile);
+        fwrite(events, sizeof(struct event), count, eventFile);
+    }
+
+    if (dropped) {
+        printf("%ld events did not fit in the buffer and were dropped; -n makes room for more.\n", dropped);
+    }
+    fclose(eventFile);
+    free(events);
+    events = NULL;
+}
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "allocator.h"
+
+/* Each histogram counts latencies in buckets that are exact below
+   LATENCY_SUB nanoseconds and then split every power of two into
+   LATENCY_SUB equal parts, so any value is reported within about 3% of
+   what it was, from nanoseconds to minutes, in a fixed array. Workers
+   record into the same histograms, so counts are added atomically */
+
+#define LATENCY_SUB_LOG2 5
+#define LATENCY_SUB (1 << LATENCY_SUB_LOG2)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_LOG2 + 1) * LATENCY_SUB)
+
+typedef struct histogram {
+    long counts[LATENCY_BUCKETS]; /* latencies that fell in each bucket */
+    long count; /* latencies recorded */
+    long total; /* sum of them, in nanoseconds */
+    long max; /* longest of them */
+} histogram;
+
+struct histogram histograms[TIMED_KINDS];
+
+const char *timedNames[TIMED_KINDS] = { "RQ first", "RQ best", "RQ worst", "RQ next", "RQ tlsf", "RL", "RS", "C", "RQB",
+                                           "RLB" };
+
+long latencyClock() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+enum timed timedRequest(char flag) {
+
+    return flag == 'B' ? TIMED_BEST : flag == 'W' ? TIMED_WORST : flag == 'N' ? TIMED_NEXT :
+           flag == 'T' ? TIMED_TLSF : TIMED_FIRST;
+}
+
+int latencyBucket(long nanoseconds) {
+
+    if (nanoseconds < LATENCY_SUB) {
+        return nanoseconds < 0 ? 0 : (int) nanoseconds;
+    }
+    int e = 63 - __builtin_clzl(nanoseconds);
+    return (e - LATENCY_SUB_LOG2 + 1) * LATENCY_SUB + (int) (nanoseconds >> (e - LATENCY_SUB_LOG2)) - LATENCY_SUB;
+}
+
+/* returns the highest latency that falls in a bucket */
+long bucketCeiling(int b) {
+
+    if (b < LATENCY_SUB) {
+        return b;
+    }
+    int e = b / LATENCY_SUB + LATENCY_SUB_LOG2 - 1;
+    long low = (long) (b % LATENCY_SUB + LATENCY_SUB) << (e - LATENCY_SUB_LOG2);
+    return low + (1L << (e - LATENCY_SUB_LOG2)) - 1;
+}
+
+void recordLatency(enum timed kind, long nanoseconds) {
+
+    struct histogram *h = &histograms[kind];
+
+    __atomic_fetch_add(&h->counts[latencyBucket(nanoseconds)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->total, nanoseconds, __ATOMIC_RELAXED);
+
+    long max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (nanoseconds > max &&
+           !__atomic_compare_exchange_n(&h->max, &max, nanoseconds, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/* returns the latency below which a fraction of a histogram's counts lie */
+long percentile(struct histogram *h, double fraction) {
+
+    long rank = (long) (fraction * h->count);
+    if (rank >= h->count) {
+        rank = h->count - 1;
+    }
+
+    long seen = 0;
+    int b;
+    for (b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen > rank) {
+            long ceiling = bucketCeiling(b);
+            return ceiling < h->max ? ceiling : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* moves a histogram's counts into a copy, leaving it empty. Workers may
+   still be recording into it, so every field is taken with an atomic
+   exchange and a latency lands in either the copy or the next report */
+void takeHistogram(struct histogram *h, struct histogram *copy) {
+
+    int b;
+    for (b = 0; b < LATENCY_BUCKETS; b++) {
+        copy->counts[b] = __atomic_exchange_n(&h->counts[b], 0, __ATOMIC_RELAXED);
+    }
+    copy->count = __atomic_exchange_n(&h->count, 0, __ATOMIC_RELAXED);
+    copy->total = __atomic_exchange_n(&h->total, 0, __ATOMIC_RELAXED);
+    copy->max = __atomic_exchange_n(&h->max, 0, __ATOMIC_RELAXED);
+}
+
+void printLatency() {
+
+    printf("\n%-9s %10s %10s %10s %10s %10s %10s %12s\n", "command", "count", "mean ns", "p50 ns",
+           "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+
+    /* each report covers the commands since the last one */
+    int k;
+    for (k = 0; k < TIMED_KINDS; k++) {
+        struct histogram h;
+        takeHistogram(&histograms[k], &h);
+
+        /* a latency being recorded may have reached its bucket but not
+           the count or the max, so go by what the buckets hold */
+        h.count = 0;
+        int b;
+        for (b = 0; b < LATENCY_BUCKETS; b++) {
+            h.count += h.counts[b];
+            if (h.counts[b] && h.max <= (b > 0 ? bucketCeiling(b - 1) : -1)) {
+                h.max = bucketCeiling(b);
+            }
+        }
+        if (h.count == 0) {
+            continue;
+        }
+        printf("%-9s %10ld %10ld %10ld %10ld %10ld %10ld %12ld\n", timedNames[k], h.count, h.total / h.count,
+               percentile(&h, 0.5), percentile(&h, 0.9), percentile(&h, 0.99), percentile(&h, 0.999), h.max);
+    }
+    printf("\n");
+}
@@ -0,0 +1,560 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "allocator.h"
+
+#define BATCH_BUFFER (1 << 20) /* stdout buffer size in batch mode */
+
+bool shouldrun = true; /* boolean to determine when the user quits */
+
+#define BARRIER -1 /* a place in a worker's lines where all of them meet */
+
+pthread_barrier_t batchBarrier; /* where workers meet around a batch command */
+
+typedef struct job {
+    int id; /* index of the worker */
+    struct command *commands; /* every command of the trace */
+    int *mine; /* indexes of the lines this worker runs, in order, with
+                  BARRIER wherever it waits for every other worker */
+    int count; /* number of lines this worker runs */
+    struct instance memory; /* the memory the worker replays into */
+    struct summary totals; /* what the worker did */
+} job;
+
+/* runs a single command, returning false once the user quits */
+bool runCommand(struct command *c);
+
+/* reads a whole trace and replays it on several worker threads, every
+   command naming a process on the worker that name hashes to and every
+   other command on the first worker. A batch names processes of every
+   worker, so the first one runs it once the others have finished what
+   came before and they wait for it */
+void replayThreaded(FILE *in);
+
+/* runs one worker's share of a threaded replay */
+void *runJob(void *arg);
+
+/* prints what happened during a batch run */
+void printSummary(double seconds);
+
+/* prints how to start the allocator */
+void printUsage();
+
+int main(int argc, char *argv[]) {
+
+    chooseKernels(NULL);
+
+    if (argc == 4 && strcmp(argv[1], "-convert") == 0) {
+        return convertTrace(argv[2], argv[3]) < 0 ? -1 : 0;
+    }
+
+    if (argc < 2) {
+        printf(RED "\nPlease enter a positive number of bytes to be allocated.\n\n" END);
+        return -1;
+    }
+
+    char *trace = NULL;
+    char *snapshot = NULL;
+    char *timeline = NULL; /* file to write events to, NULL if not recording */
+    char *strategies = NULL; /* strategies to compare, NULL if not comparing */
+    long sizes[argc]; /* memory sizes to compare, the first from argv[1] */
+    int sizeCount = 1;
+    int count = 1; /* arenas */
+    int i;
+    for (i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0) {
+            batch = true;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            compactOnFailure = true;
+        } else if (strcmp(argv[i], "-d") == 0) {
+            backed = true;
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            compactAbove = atof(argv[++i]) / 100;
+            if (compactAbove <= 0 || compactAbove >= 1) {
+                printUsage();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            compactEvery = strtol(argv[++i], NULL, 10);
+            if (compactEvery <= 0) {
+                printUsage();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "list") == 0) {
+                mode = LIST;
+            } else if (strcmp(argv[i], "buddy") == 0) {
+                mode = BUDDY;
+            } else if (strcmp(argv[i], "tlsf") == 0) {
+                mode = TLSF;
+            } else if (strcmp(argv[i], "table") == 0) {
+                mode = TABLE;
+            } else {
+                printUsage();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            snapshot = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            timeline = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            eventCapacity = strtol(argv[++i], NULL, 10);
+            if (eventCapacity <= 0 || eventCapacity > MAX) {
+                printUsage();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            strategies = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            sizes[sizeCount++] = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sampleEvery = atoi(argv[++i]);
+            if (sampleEvery <= 0) {
+                printUsage();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "name") == 0) {
+                policy = BYNAME;
+            } else if (strcmp(argv[i], "thread") == 0) {
+                policy = BYTHREAD;
+            } else {
+                printUsage();
+                return -1;
+            }
+        } else if (batch && !trace) {
+            trace = argv[i];
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+
+    bytes = strtol(argv[1], NULL, 10);
+    sizes[0] = bytes;
+    for (i = 1; i < sizeCount; i++) {
+        if (sizes[i] <= 0 || sizes[i] > MAX || count > sizes[i]) {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if (bytes <= 0) {
+        printf(RED "\nPlease enter a positive number of bytes to be allocated.\n\n" END);
+        return -1;
+    } else if (bytes > MAX) {
+        printf(RED "\nPlease enter a positive number of bytes less than or equal to %ld.\n\n" END, MAX);
+        return -1;
+    } else if (count <= 0 || count > bytes || workers <= 0 || (workers > 1 && !batch) ||
+               (mode == TABLE && (backed || snapshot))) {
+        printUsage();
+        return -1;
+    } else if ((strategies || sizeCount > 1) &&
+               (!batch || snapshot || sampleEvery || timeline || !strategies || !strategies[0] ||
+                strspn(strategies, "FBWNT") != strlen(strategies))) {
+        printUsage();
+        return -1;
+    }
+
+    if (strategies) {
+        /* every allocator sets up memory of its own, and -t says how many
+           run at once rather than how many threads share one */
+        FILE *in = trace ? fopen(trace, "r") : stdin;
+        if (!in) {
+            printf("Could not open trace %s.\n", trace);
+            return -1;
+        }
+        int threads = workers;
+        workers = 1;
+        int result = compareStrategies(in, strategies, sizes, sizeCount, count, threads);
+        if (in != stdin) {
+            fclose(in);
+        }
+        return result < 0 ? -1 : 0;
+    }
+
+    if (timeline && startEvents(timeline) < 0) {
+        return -1;
+    }
+
+    setupArenas(count);
+    if (mapBacking() < 0) {
+        freeArenas();
+        return -1;
+    }
+    if (snapshot && restoreSnapshot(snapshot) < 0) {
+        freeArenas();
+        unmapSnapshot();
+        return -1;
+    }
+    if (sampleEvery) {
+        setupSampler(sampleEvery);
+    }
+
+    FILE *in = stdin;
+    bool binary = false;
+    if (batch) {
+        if (trace) {
+            in = fopen(trace, "r");
+            if (!in) {
+                printf("Could not open trace %s.\n", trace);
+                return -1;
+            }
+            binary = isBinaryTrace(in);
+        }
+        setvbuf(stdout, NULL, _IOFBF, BATCH_BUFFER);
+    }
+
+    if (debug) {
+        printf("\nMaximum number of bytes: %ld\n\n", bytes);
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    if (binary) {
+        if (replayBinary(in) < 0) {
+            fclose(in);
+            freeSampler();
+            freeArenas();
+            unmapSnapshot();
+            return -1;
+        }
+    } else if (workers > 1) {
+        replayThreaded(in);
+    }
+
+    struct reader *lines = workers == 1 && !binary ? openReader(in) : NULL;
+    while (shouldrun && lines) {
+        if (!batch) {
+            printf(BLU "allocator" END "$ ");
+            fflush(stdout);
+        }
+
+        char *line = readLine(lines);
+        if (!line) {
+            break; /* end of input */
+        }
+
+        struct command c;
+        splitCommand(line, &c);
+        shouldrun = runCommand(&c);
+    }
+    if (lines) {
+        closeReader(lines);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (batch) {
+        printSummary((end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9);
+        if (in != stdin) {
+            fclose(in);
+        }
+    }
+
+    freeSampler();
+    freeArenas();
+    unmapSnapshot();
+
+    return 0;
+}
+
+void replayThreaded(FILE *in) {
+
+    long length;
+    char *text = readInput(in, &length);
+    char *at = text;
+
+    /* every line is split once, where it lies in the text */
+    int capacity = 1024;
+    int count = 0;
+    struct command *commands = (struct command *) malloc(sizeof(struct command) * capacity);
+    int *owner = (int *) malloc(sizeof(int) * capacity);
+
+    char *line;
+    while ((line = nextLine(&at, text + length))) {
+        struct command *c = &commands[count];
+        splitCommand(line, c);
+        if (c->count == 0) {
+            continue;
+        }
+        if (isQuit(c)) {
+            totals.commands++;
+            break;
+        }
+
+        /* every command for a name runs on one worker, in trace order */
+        owner[count] = 0;
+        if ((isCommand(c, "RQ") || isCommand(c, "RL") || isCommand(c, "RS")) && c->count > 1) {
+            owner[count] = (int) (((unsigned long long) hashName(c->words[1]) * workers) >> 32);
+        } else if (isCommand(c, "RQB") || isCommand(c, "RLB")) {
+            owner[count] = BARRIER;
+        }
+
+        if (++count == capacity) {
+            capacity *= 2;
+            commands = (struct command *) realloc(commands, sizeof(struct command) * capacity);
+            owner = (int *) realloc(owner, sizeof(int) * capacity);
+        }
+    }
+
+    struct job *jobs = (struct job *) calloc(workers, sizeof(struct job));
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * workers);
+
+    /* a batch is run by the first worker between two barriers */
+    int barriers = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (owner[i] == BARRIER) {
+            barriers += 2;
+            jobs[0].count++;
+        } else {
+            jobs[owner[i]].count++;
+        }
+    }
+    for (i = 0; i < workers; i++) {
+        jobs[i].id = i;
+        jobs[i].commands = commands;
+        saveInstance(&jobs[i].memory);
+        jobs[i].mine = (int *) malloc(sizeof(int) * (jobs[i].count + barriers + 1));
+        jobs[i].count = 0;
+    }
+    for (i = 0; i < count; i++) {
+        if (owner[i] == BARRIER) {
+            int w;
+            for (w = 0; w < workers; w++) {
+                jobs[w].mine[jobs[w].count++] = BARRIER;
+            }
+            jobs[0].mine[jobs[0].count++] = i;
+            for (w = 0; w < workers; w++) {
+                jobs[w].mine[jobs[w].count++] = BARRIER;
+            }
+        } else {
+            struct job *j = &jobs[owner[i]];
+            j->mine[j->count++] = i;
+        }
+    }
+    pthread_barrier_init(&batchBarrier, NULL, workers);
+
+    for (i = 0; i < workers; i++) {
+        pthread_create(&threads[i], NULL, runJob, &jobs[i]);
+    }
+    for (i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+        addTotals(&totals, &jobs[i].totals);
+        free(jobs[i].mine);
+    }
+    pthread_barrier_destroy(&batchBarrier);
+
+    free(threads);
+    free(jobs);
+    free(owner);
+    free(commands);
+    free(text);
+}
+
+void *runJob(void *arg) {
+
+    struct job *j = (struct job *) arg;
+
+    worker = j->id;
+    useInstance(&j->memory);
+
+    int i;
+    for (i = 0; i < j->count; i++) {
+        if (j->mine[i] == BARRIER) {
+            pthread_barrier_wait(&batchBarrier);
+        } else {
+            runCommand(&j->commands[j->mine[i]]);
+        }
+    }
+
+    j->totals = totals;
+    return NULL;
+}
+
+bool runCommand(struct command *c) {
+
+    if (c->count == 0) {
+        return true; /* blank line */
+    }
+
+    totals.commands++;
+    long begin = latencyClock(); /* for compaction, the others are timed once they parse */
+
+    if (isQuit(c)) {
+        return false; /* exit */
+
+    } else if (isCommand(c, "RQ")) {
+        if (allocateProcess(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "RL")) {
+        if (releaseProcess(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "RS")) {
+        if (resizeProcess(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "RQB")) {
+        if (requestBatch(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "RLB")) {
+        if (releaseBatch(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "AT")) {
+        if (lookupAddress(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "RANGE")) {
+        if (lookupRange(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "SNAPSHOT")) {
+        if (writeSnapshot(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "SAMPLES") && c->count <= 2) {
+        if (dumpSamples(c) < 0) {
+            totals.errors++;
+        }
+
+    } else if (isCommand(c, "C") && c->count == 1) {
+        compact();
+        recordLatency(TIMED_COMPACT, latencyClock() - begin);
+
+    } else if (isCommand(c, "STAT") && c->count == 1) {
+        stat();
+
+    } else if (isCommand(c, "STATS") && c->count == 1) {
+        printStats();
+
+    } else if (isCommand(c, "LATENCY") && c->count == 1) {
+        printLatency();
+
+    } else if (c->count == 4) {
+        report(RED "\nPlease request allocation using the \"RQ\" command.\n\n" END);
+        totals.errors++;
+
+    } else if (c->count == 2) {
+        report(RED "\nPlease request release using the \"RL\" command.\n\n" END);
+        totals.errors++;
+
+    } else {
+        report(RED "Invalid command.\n" END);
+        totals.errors++;
+
+    }
+
+    takeSample();
+    return true;
+}
+
+void printSummary(double seconds) {
+
+    long requests = totals.placed + totals.failed;
+
+    printf("\nReplayed %ld commands in %.3f seconds (%.0f commands/sec).\n",
+           totals.commands, seconds, seconds > 0 ? totals.commands / seconds : 0.0);
+    printf("Requests: %ld placed, %ld failed (%.2f%% failure rate)\n",
+           totals.placed, totals.failed, requests ? 100.0 * totals.failed / requests : 0.0);
+    printf("Releases: %ld\n", totals.released);
+    if (totals.resized || totals.relocated || totals.resizeFailed) {
+        printf("Resizes: %ld in place, %ld moved, %ld failed\n", totals.resized, totals.relocated,
+               totals.resizeFailed);
+    }
+    printf("Compactions: %ld (%ld bytes moved)\n", totals.compactions, totals.moved);
+    printPolicies(&totals);
+    if (backed) {
+        printBacking(&totals);
+    }
+    printf("Rejected commands: %ld\n", totals.errors);
+    long allocated = 0;
+    long reserved = 0;
+    int i;
+    for (i = 0; i < arenaCount; i++) {
+        allocated += arenas[i].allocated;
+        reserved += arenas[i].buddies.reserved;
+    }
+
+    printf("Bytes in use: %ld of %ld\n", allocated, bytes);
+    if (arenaCount > 1) {
+        printf("Arenas: %d, %s routing, %d worker%s\n", arenaCount,
+               policy == BYNAME ? "name" : "thread", workers, workers == 1 ? "" : "s");
+    }
+    if (mode == BUDDY) {
+        printf("Internal fragmentation: %ld of %ld reserved bytes\n", reserved - allocated, reserved);
+    }
+    printf("\n");
+}
+
+void printUsage() {
+
+    printf(RED "\nUsage: allocator [bytes] [-e list|buddy|tlsf|table] [-d] [-c] [-l percent]\n" END);
+    printf(RED "                 [-i releases] [-a arenas]\n" END);
+    printf(RED "                 [-p name|thread] [-t threads] [-s commands]\n" END);
+    printf(RED "                 [-r snapshot] [-o events [-n events]] [-x strategies [-m bytes]...]\n" END);
+    printf(RED "                 [-b [trace file]]\n" END);
+    printf("\n-e picks the engine: list places processes in an address-ordered list\n");
+    printf("of holes (the default), buddy rounds every request up to a power-of-two\n");
+    printf("block, and tlsf keeps the list but indexes holes only by size class so\n");
+    printf("every request and release takes constant time. Those two ignore the\n");
+    printf("strategy flag. table keeps the segments in chunks of arrays in address\n");
+    printf("order instead of a list, so the fits scan hole sizes and nothing else;\n");
+    printf("it has no snapshots or backing memory (-r, -d).\n");
+    printf("\n-d puts real memory behind the simulated one. Every process writes a\n");
+    printf("pattern into its bytes, compaction moves them (remapping whole pages\n");
+    printf("where it can) and checks the pattern after every move.\n");
+    printf("\n-c compacts just enough memory to satisfy a request that would\n");
+    printf("otherwise fail for lack of a large enough hole. -l compacts an arena\n");
+    printf("whenever a release leaves more than that percentage of its free bytes\n");
+    printf("outside its largest hole, and -i compacts an arena every so many\n");
+    printf("releases. The summary says what each of them moved and how many\n");
+    printf("requests it rescued.\n");
+    printf("\n-a splits memory into that many arenas, each with its own holes and\n");
+    printf("names. A process goes first to the arena its name hashes to (-p name,\n");
+    printf("the default) or to the arena of the thread asking (-p thread), and\n");
+    printf("to the other arenas in turn if it does not fit there.\n");
+    printf("\n-s records the free bytes, holes, largest hole and bytes in use\n");
+    printf("every so many commands, keeping the latest %d samples for SAMPLES\n", SAMPLE_RING);
+    printf("to write out as CSV.\n");
+    printf("\n-r starts from a snapshot written by SNAPSHOT, taken of memory of the\n");
+    printf("same size, arenas and engine.\n");
+    printf("\n-o records every request, release, hole split and coalesce and\n");
+    printf("compaction move with its time, address and size, and writes them out\n");
+    printf("at exit: as Chrome trace JSON if the file name ends in .json, to open\n");
+    printf("in chrome://tracing or Perfetto, and in a compact binary form otherwise.\n");
+    printf("-n sets how many events it keeps (default 2097152), 40 bytes each.\n");
+    printf("\n-b replays commands from the trace file (or standard input) without\n");
+    printf("prompts or per-command messages and prints a summary at the end.\n");
+    printf("With -t it reads the whole trace first and replays it on that many\n");
+    printf("threads, each process's commands kept in order on one of them.\n");
+    printf("A binary trace, made with \"allocator -convert trace.txt trace.bin\",\n");
+    printf("is replayed straight from the file without parsing any text.\n");
+    printf("\n-x, with -b, replays the trace against a separate allocator for each\n");
+    printf("strategy listed (say FBW), forcing every request to use it, and for\n");
+    printf("each further memory size given with -m. -t runs that many of them at\n");
+    printf("once. A table of failures, fragmentation, compactions and time follows.\n\n");
+}
@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "allocator.h"
+
+int sampleEvery = 0; /* commands between samples, 0 if not sampling */
+
+struct sample *samples = NULL; /* ring of the latest samples */
+long sampleCount = 0; /* samples taken so far, including overwritten ones */
+
+void arenaMetrics(struct metrics *m) {
+
+    if (arenaEmpty()) {
+        /* memory nobody has asked for yet is one hole, never indexed */
+        m->freeBytes += current->bytes;
+        m->holeCount++;
+        if (current->bytes > m->largest) {
+            m->largest = current->bytes;
+        }
+        return;
+    }
+
+    m->freeBytes += current->freeBytes;
+    m->holeCount += current->holeCount;
+    m->allocated += current->allocated;
+
+    long largest = largestHole();
+    if (largest > m->largest) {
+        m->largest = largest;
+    }
+}
+
+void gatherMetrics(struct metrics *m) {
+
+    memset(m, 0, sizeof(*m));
+
+    struct arena *home = current;
+    int i;
+    for (i = 0; i < arenaCount; i++) {
+        lockArena(&arenas[i]);
+        current = &arenas[i];
+        arenaMetrics(m);
+        unlockArena(&arenas[i]);
+    }
+    current = home;
+}
+
+double externalFragmentation(struct metrics *m) {
+
+    return m->freeBytes > 0 ? 1.0 - (double) m->largest / m->freeBytes : 0.0;
+}
+
+void printStats() {
+
+    struct metrics m;
+    gatherMetrics(&m);
+
+    printf("\nFree bytes: %ld of %ld\n", m.freeBytes, bytes);
+    printf("Holes: %d\n", m.holeCount);
+    printf("Largest hole: %ld bytes\n", m.largest);
+    printf("External fragmentation: %.2f%%\n", 100.0 * externalFragmentation(&m));
+    printf("Bytes in use: %ld\n\n", m.allocated);
+}
+
+void setupSampler(int every) {
+
+    sampleEvery = every;
+    samples = (struct sample *) malloc(sizeof(struct sample) * SAMPLE_RING);
+    sampleCount = 0;
+}
+
+void freeSampler() {
+
+    free(samples);
+    samples = NULL;
+    sampleEvery = 0;
+}
+
+void takeSample() {
+
+    /* with several workers only the first keeps time, by its own commands */
+    if (!sampleEvery || worker != 0 || totals.commands % sampleEvery != 0) {
+        return;
+    }
+
+    struct sample *s = &samples[sampleCount % SAMPLE_RING];
+    s->command = totals.commands;
+    gatherMetrics(&s->m);
+    sampleCount++;
+}
+
+int dumpSamples(struct command *c) {
+
+    FILE *out = stdout;
+    if (c->count > 1) {
+        out = fopen(c->words[1], "w");
+        if (!out) {
+            report(RED "\nCould not open %s.\n\n" END, c->words[1]);
+            return -1;
+        }
+    }
+
+    fprintf(out, "command,free_bytes,holes,largest_hole,external_fragmentation,allocated\n");
+
+    long first = sampleCount > SAMPLE_RING ? sampleCount - SAMPLE_RING : 0;
+    long i;
+    for (i = first; i < sampleCount; i++) {
+        struct sample *s = &samples[i % SAMPLE_RING];
+        fprintf(out, "%ld,%ld,%d,%ld,%.4f,%ld\n", s->command, s->m.freeBytes, s->m.holeCount,
+                s->m.largest, externalFragmentation(&s->m), s->m.allocated);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "allocator.h"
+
+#define READ_BUFFER (1 << 20) /* bytes a reader starts with and reads at a time */
+
+/* Lines are handed out straight from the reader's buffer and split into
+   words where they lie, so running a command copies and allocates
+   nothing. The buffer only grows for a line longer than itself */
+
+typedef struct reader {
+    int fd; /* descriptor the input is read from */
+    char *buffer; /* input read and not yet handed out, plus a terminator */
+    size_t capacity; /* bytes the buffer holds */
+    size_t start; /* where the next line begins */
+    size_t end; /* end of the input read so far */
+    bool done; /* whether the input has run out */
+} reader;
+
+struct reader *openReader(FILE *in) {
+
+    struct reader *r = (struct reader *) calloc(1, sizeof(struct reader));
+    r->fd = fileno(in);
+    r->capacity = READ_BUFFER;
+    r->buffer = (char *) malloc(r->capacity);
+
+    /* the stream may have read ahead of where it stands, say after
+       looking for a binary trace's header, so start from where it says */
+    long at = ftell(in);
+    if (at >= 0) {
+        lseek(r->fd, at, SEEK_SET);
+    }
+
+    return r;
+}
+
+/* cuts the line starting at *at off at its newline (and any carriage
+   return before it), leaving *at at the line after it */
+char *cutLine(char **at, char *newline) {
+
+    char *line = *at;
+    *at = newline + 1;
+    if (newline > line && newline[-1] == '\r') {
+        newline--;
+    }
+    *newline = '\0';
+    return line;
+}
+
+char *readLine(struct reader *r) {
+
+    size_t searched = r->start; /* where the newline search left off */
+
+    while (true) {
+        char *newline = (char *) memchr(r->buffer + searched, '\n', r->end - searched);
+        if (newline) {
+            char *at = r->buffer + r->start;
+            char *line = cutLine(&at, newline);
+            r->start = at - r->buffer;
+            return line;
+        }
+        searched = r->end;
+
+        if (r->done) {
+            if (r->start == r->end) {
+                return NULL;
+            }
+            /* the last line need not end in a newline */
+            char *line = r->buffer + r->start;
+            r->buffer[r->end] = '\0';
+            r->start = r->end;
+            return line;
+        }
+
+        /* keep the unfinished line, at the front of the buffer, and make
+           room for it to go on if it already fills the buffer */
+        if (r->start > 0) {
+            memmove(r->buffer, r->buffer + r->start, r->end - r->start);
+            r->end -= r->start;
+            searched -= r->start;
+            r->start = 0;
+        }
+        if (r->end + 1 == r->capacity) {
+            r->capacity *= 2;
+            r->buffer = (char *) realloc(r->buffer, r->capacity);
+        }
+
+        /* a terminal hands over a line at a time, a file a buffer full */
+        ssize_t got = read(r->fd, r->buffer + r->end, r->capacity - r->end - 1);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            r->done = true;
+        } else {
+            r->end += got;
+        }
+    }
+}
+
+void closeReader(struct reader *r) {
+
+    free(r->buffer);
+    free(r);
+}
+
+char *readInput(FILE *in, long *length) {
+
+    struct reader *r = openReader(in);
+
+    /* read until the input runs out, growing the buffer as it fills */
+    while (!r->done) {
+        if (r->end + 1 == r->capacity) {
+            r->capacity *= 2;
+            r->buffer = (char *) realloc(r->buffer, r->capacity);
+        }
+        ssize_t got = read(r->fd, r->buffer + r->end, r->capacity - r->end - 1);
+        if (got > 0) {
+            r->end += got;
+        } else if (got == 0 || errno != EINTR) {
+            r->done = true;
+        }
+    }
+
+    char *text = r->buffer;
+    text[r->end] = '\0';
+    *length = r->end;
+    free(r);
+    return text;
+}
+
+char *nextLine(char **at, char *end) {
+
+    if (*at >= end) {
+        return NULL;
+    }
+    char *newline = (char *) memchr(*at, '\n', end - *at);
+    if (!newline) {
+        /* the text is null terminated at end */
+        char *line = *at;
+        *at = end;
+        return line;
+    }
+    return cutLine(at, newline);
+}
+
+void splitCommand(char *line, struct command *c) {
+
+    c->count = 0;
+    char *at = line;
+    while (true) {
+        at += strspn(at, " \t\r");
+        if (*at == '\0') {
+            break;
+        }
+        if (c->count < MAX_WORDS) {
+            c->words[c->count] = at;
+        }
+        c->count++;
+
+        at += strcspn(at, " \t\r");
+        if (*at == '\0') {
+            break;
+        }
+        *at++ = '\0';
+    }
+}
+
+char *nextWord(char *word) {
+
+    word += strlen(word) + 1;
+    return word + strspn(word, " \t\r");
+}
+
+bool isCommand(struct command *c, const char *word) {
+
+    return c->count > 0 && strcmp(c->words[0], word) == 0;
+}
+
+bool isQuit(struct command *c) {
+
+    return c->count == 1 && (strcmp(c->words[0], "X") == 0 || strcmp(c->words[0], "q") == 0);
+}
+
+bool parseNumber(char *word, long *value) {
+
+    char *end;
+    errno = 0;
+    *value = strtol(word, &end, 10);
+    return end != word && *end == '\0' && errno == 0;
+}
+
+bool parseStrategy(char *word, char *flag) {
+
+    if (word[0] == '\0' || word[1] != '\0' || !strchr("FBWNT", word[0])) {
+        return false;
+    }
+    *flag = word[0];
+    return true;
+}
@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+#include "allocator.h"
+
+/* Hole sizes are packed in arrays with a process counting as a hole of 0
+   bytes, so looking for a hole is a scan that can compare several sizes
+   at once: four per instruction with AVX2, two with SSE4.2, and one at a
+   time otherwise. Sizes are 64 bits wide, and each loop takes two vectors
+   a turn so the compares overlap. The kernels are picked once, at startup,
+   from what the processor supports */
+
+int firstFittingScalar(const long *holes, int count, long size) {
+
+    int i;
+    for (i = 0; i < count; i++) {
+        if (holes[i] >= size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int smallestFittingScalar(const long *holes, int count, long size) {
+
+    int best = -1;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (holes[i] >= size && (best < 0 || holes[i] < holes[best])) {
+            best = i;
+            if (holes[i] == size) {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+long largestScalar(const long *holes, int count) {
+
+    long largest = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (holes[i] > largest) {
+            largest = holes[i];
+        }
+    }
+    return largest;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("avx2")))
+int firstFittingAvx2(const long *holes, int count, long size) {
+
+    /* sizes are never negative, so size - 1 cannot wrap */
+    __m256i below = _mm256_set1_epi64x(size - 1);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) &holes[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *) &holes[i + 4]);
+        int fits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, below))) |
+                   _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(b, below))) << 4;
+        if (fits) {
+            return i + __builtin_ctz(fits);
+        }
+    }
+    for (; i < count; i++) {
+        if (holes[i] >= size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+int firstEqualAvx2(const long *holes, int count, long size) {
+
+    __m256i wanted = _mm256_set1_epi64x(size);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) &holes[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *) &holes[i + 4]);
+        int equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, wanted))) |
+                    _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(b, wanted))) << 4;
+        if (equal) {
+            return i + __builtin_ctz(equal);
+        }
+    }
+    for (; i < count; i++) {
+        if (holes[i] == size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+int smallestFittingAvx2(const long *holes, int count, long size) {
+
+    /* the smallest size that fits, with those that do not read as the
+       largest long, then the first hole of that size */
+    __m256i below = _mm256_set1_epi64x(size - 1);
+    __m256i none = _mm256_set1_epi64x(LONG_MAX);
+    __m256i lowA = none;
+    __m256i lowB = none;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) &holes[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *) &holes[i + 4]);
+        a = _mm256_blendv_epi8(none, a, _mm256_cmpgt_epi64(a, below));
+        b = _mm256_blendv_epi8(none, b, _mm256_cmpgt_epi64(b, below));
+        lowA = _mm256_blendv_epi8(lowA, a, _mm256_cmpgt_epi64(lowA, a));
+        lowB = _mm256_blendv_epi8(lowB, b, _mm256_cmpgt_epi64(lowB, b));
+    }
+    lowA = _mm256_blendv_epi8(lowA, lowB, _mm256_cmpgt_epi64(lowA, lowB));
+
+    long lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, lowA);
+    long best = LONG_MAX;
+    int lane;
+    for (lane = 0; lane < 4; lane++) {
+        if (lanes[lane] < best) {
+            best = lanes[lane];
+        }
+    }
+    for (; i < count; i++) {
+        if (holes[i] >= size && holes[i] < best) {
+            best = holes[i];
+        }
+    }
+
+    return best == LONG_MAX ? -1 : firstEqualAvx2(holes, count, best);
+}
+
+__attribute__((target("avx2")))
+long largestAvx2(const long *holes, int count) {
+
+    __m256i highA = _mm256_setzero_si256();
+    __m256i highB = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) &holes[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *) &holes[i + 4]);
+        highA = _mm256_blendv_epi8(highA, a, _mm256_cmpgt_epi64(a, highA));
+        highB = _mm256_blendv_epi8(highB, b, _mm256_cmpgt_epi64(b, highB));
+    }
+    highA = _mm256_blendv_epi8(highA, highB, _mm256_cmpgt_epi64(highB, highA));
+
+    long lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, highA);
+    long largest = 0;
+    int lane;
+    for (lane = 0; lane < 4; lane++) {
+        if (lanes[lane] > largest) {
+            largest = lanes[lane];
+        }
+    }
+    for (; i < count; i++) {
+        if (holes[i] > largest) {
+            largest = holes[i];
+        }
+    }
+    return largest;
+}
+
+__attribute__((target("sse4.2")))
+int firstFittingSse4(const long *holes, int count, long size) {
+
+    __m128i below = _mm_set1_epi64x(size - 1);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &holes[i]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &holes[i + 2]);
+        int fits = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(a, below))) |
+                   _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(b, below))) << 2;
+        if (fits) {
+            return i + __builtin_ctz(fits);
+        }
+    }
+    for (; i < count; i++) {
+        if (holes[i] >= size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+__attribute__((target("sse4.2")))
+int firstEqualSse4(const long *holes, int count, long size) {
+
+    __m128i wanted = _mm_set1_epi64x(size);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &holes[i]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &holes[i + 2]);
+        int equal = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(a, wanted))) |
+                    _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(b, wanted))) << 2;
+        if (equal) {
+            return i + __builtin_ctz(equal);
+        }
+    }
+    for (; i < count; i++) {
+        if (holes[i] == size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+__attribute__((target("sse4.2")))
+int smallestFittingSse4(const long *holes, int count, long size) {
+
+    __m128i below = _mm_set1_epi64x(size - 1);
+    __m128i none = _mm_set1_epi64x(LONG_MAX);
+    __m128i lowA = none;
+    __m128i lowB = none;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &holes[i]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &holes[i + 2]);
+        a = _mm_blendv_epi8(none, a, _mm_cmpgt_epi64(a, below));
+        b = _mm_blendv_epi8(none, b, _mm_cmpgt_epi64(b, below));
+        lowA = _mm_blendv_epi8(lowA, a, _mm_cmpgt_epi64(lowA, a));
+        lowB = _mm_blendv_epi8(lowB, b, _mm_cmpgt_epi64(lowB, b));
+    }
+    lowA = _mm_blendv_epi8(lowA, lowB, _mm_cmpgt_epi64(lowA, lowB));
+
+    long lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, lowA);
+    long best = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    for (; i < count; i++) {
+        if (holes[i] >= size && holes[i] < best) {
+            best = holes[i];
+        }
+    }
+
+    return best == LONG_MAX ? -1 : firstEqualSse4(holes, count, best);
+}
+
+__attribute__((target("sse4.2")))
+long largestSse4(const long *holes, int count) {
+
+    __m128i highA = _mm_setzero_si128();
+    __m128i highB = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &holes[i]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &holes[i + 2]);
+        highA = _mm_blendv_epi8(highA, a, _mm_cmpgt_epi64(a, highA));
+        highB = _mm_blendv_epi8(highB, b, _mm_cmpgt_epi64(b, highB));
+    }
+    highA = _mm_blendv_epi8(highA, highB, _mm_cmpgt_epi64(highB, highA));
+
+    long lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, highA);
+    long largest = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    for (; i < count; i++) {
+        if (holes[i] > largest) {
+            largest = holes[i];
+        }
+    }
+    return largest;
+}
+
+#endif
+
+struct kernels scan = { "scalar", firstFittingScalar, smallestFittingScalar, largestScalar };
+
+int chooseKernels(const char *name) {
+
+    struct kernels scalar = { "scalar", firstFittingScalar, smallestFittingScalar, largestScalar };
+
+#ifdef HAVE_X86_KERNELS
+    struct kernels avx2 = { "avx2", firstFittingAvx2, smallestFittingAvx2, largestAvx2 };
+    struct kernels sse4 = { "sse4.2", firstFittingSse4, smallestFittingSse4, largestSse4 };
+
+    __builtin_cpu_init();
+    bool hasAvx2 = __builtin_cpu_supports("avx2");
+    bool hasSse4 = __builtin_cpu_supports("sse4.2");
+
+    if (!name) {
+        scan = hasAvx2 ? avx2 : hasSse4 ? sse4 : scalar;
+        return 0;
+    } else if (strcmp(name, "avx2") == 0 || strcmp(name, "sse4.2") == 0) {
+        /* asked for by name, so refuse rather than fall back */
+        bool wide = strcmp(name, "avx2") == 0;
+        if (!(wide ? hasAvx2 : hasSse4)) {
+            return -1;
+        }
+        scan = wide ? avx2 : sse4;
+        return 0;
+    }
+#endif
+
+    if (name && strcmp(name, "scalar") != 0) {
+        return -1;
+    }
+    scan = scalar;
+    return 0;
+}
@@ -0,0 +1,424 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "allocator.h"
+
+#define SNAPSHOT_MAGIC "ALLOCSNP"
+#define SNAPSHOT_VERSION 2
+
+/* The file is a header followed by one section per arena: the arena's
+   counts, its segments in address order, the start of every hole in the
+   order it was filed into its free list, its names and the text of the
+   names. Every record is fixed width, so restoring is a matter of
+   pointing into the mapped file */
+
+typedef struct snapshotHeader {
+    char magic[8]; /* SNAPSHOT_MAGIC, without a terminator */
+    int version; /* SNAPSHOT_VERSION */
+    int mode; /* the engine that wrote the snapshot */
+    long bytes; /* size of memory */
+    long arenas; /* number of arena sections that follow */
+} snapshotHeader;
+
+typedef struct snapshotArena {
+    long segments; /* segment records that follow */
+    long holes; /* hole start addresses after the segments */
+    long names; /* name records after the holes */
+    long namecap; /* slots in the name table */
+    long text; /* bytes of name text after the name records, padded with
+                  zeros to a multiple of 8 so the next section is aligned */
+    long allocated; /* bytes in use by processes */
+    long reserved; /* bytes of buddy blocks handed to processes */
+    long rover; /* index of the segment next fit resumes from, -1 if none */
+} snapshotArena;
+
+typedef struct snapshotSegment {
+    long start; /* start address within the arena */
+    long end; /* end address within the arena */
+    long size; /* bytes requested, or the size of the hole */
+    int order; /* buddy order, -1 outside the buddy engine */
+    int hole; /* 1 for a hole */
+    int strategy; /* flag the process was placed with, 0 for a hole or
+                     if not known */
+    int unused; /* keeps the record a multiple of 8 bytes */
+} snapshotSegment;
+
+typedef struct snapshotName {
+    long text; /* offset of the name in the arena's text */
+    long segment; /* index of the segment carrying the name, -1 if none */
+    unsigned hash; /* cached hash of the name */
+    int slot; /* where the name sits in the name table */
+} snapshotName;
+
+void *mapped = NULL; /* the restored snapshot, which names point into */
+size_t mappedLength = 0; /* bytes mapped */
+
+/* writes the starts of a free list's holes, last first, so filing them
+   in that order puts them back in the same order */
+void writeFreeList(FILE *out, struct node *first) {
+
+    struct node *n = first;
+    while (n && n->nextFree) {
+        n = n->nextFree;
+    }
+    for (; n != NULL; n = n->prevFree) {
+        fwrite(&n->start, sizeof(n->start), 1, out);
+    }
+}
+
+/* writes the current arena's section of a snapshot */
+void writeArena(FILE *out) {
+
+    struct snapshotArena sa = { 0 };
+    sa.allocated = current->allocated;
+    sa.reserved = current->buddies.reserved;
+    sa.rover = -1;
+    sa.holes = current->holeCount;
+    sa.namecap = current->namecap;
+
+    /* which segment each name table slot is bound to, plus one */
+    long *bound = (long *) calloc(current->namecap + 1, sizeof(long));
+
+    struct node *n;
+    for (n = current->tail; n != NULL; n = n->prev) {
+        struct name *entry = findName(n->name);
+        if (entry && entry->node == n) {
+            bound[entry - current->names] = sa.segments + 1;
+        }
+        if (n == current->rover) {
+            sa.rover = sa.segments;
+        }
+        sa.segments++;
+    }
+
+    int i;
+    for (i = 0; i < current->namecap; i++) {
+        if (current->names[i].str) {
+            sa.names++;
+            sa.text += strlen(current->names[i].str) + 1;
+        }
+    }
+    long padding = -sa.text & 7;
+    sa.text += padding;
+
+    fwrite(&sa, sizeof(sa), 1, out);
+
+    for (n = current->tail; n != NULL; n = n->prev) {
+        struct snapshotSegment s = { n->start, n->end, n->size, n->order, n->hole, n->hole ? 0 : n->strategy, 0 };
+        fwrite(&s, sizeof(s), 1, out);
+    }
+
+    /* which hole of a size is taken first depends on the order of the
+       free lists, so they are kept too */
+    int k;
+    if (mode == BUDDY) {
+        for (k = 0; k < BUDDY_ORDERS; k++) {
+            writeFreeList(out, current->buddies.free[k]);
+        }
+    } else {
+        for (k = 0; k < FL_COUNT * SL_COUNT; k++) {
+            writeFreeList(out, current->classes.bins[k / SL_COUNT][k % SL_COUNT]);
+        }
+    }
+
+    long text = 0;
+    for (i = 0; i < current->namecap; i++) {
+        if (current->names[i].str) {
+            struct snapshotName r = { text, bound[i] - 1, current->names[i].hash, i };
+            fwrite(&r, sizeof(r), 1, out);
+            text += strlen(current->names[i].str) + 1;
+        }
+    }
+
+    for (i = 0; i < current->namecap; i++) {
+        if (current->names[i].str) {
+            fwrite(current->names[i].str, strlen(current->names[i].str) + 1, 1, out);
+        }
+    }
+    static const char zeros[8] = { 0 };
+    fwrite(zeros, 1, padding, out);
+
+    free(bound);
+}
+
+int writeSnapshot(struct command *c) {
+
+    if (c->count != 2) {
+        report(RED "\nTo save the state of memory to a file, structure a command as follows:\n" END);
+        report("\nSNAPSHOT [file]\n\n");
+        return -1;
+    }
+
+    /* snapshots are images of the node list, which the table has none of */
+    if (mode == TABLE) {
+        report(RED "\nThe table engine cannot save snapshots.\n\n" END);
+        return -1;
+    }
+
+    char *path = c->words[1];
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        report(RED "\nCould not open %s.\n\n" END, path);
+        return -1;
+    }
+
+    struct snapshotHeader h = { { 0 } };
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.mode = mode;
+    h.bytes = bytes;
+    h.arenas = arenaCount;
+    fwrite(&h, sizeof(h), 1, out);
+
+    int i;
+    for (i = 0; i < arenaCount; i++) {
+        lockArena(&arenas[i]);
+        current = &arenas[i];
+        writeArena(out);
+        unlockArena(&arenas[i]);
+    }
+
+    bool failed = ferror(out);
+    if (fclose(out) != 0 || failed) {
+        report(RED "\nCould not write %s.\n\n" END, path);
+        return -1;
+    }
+
+    report(GRN "\nMemory saved to %s.\n\n" END, path);
+    return 0;
+}
+
+/* returns true if segments tile the current arena in address order,
+   each as long as its size (or, in the buddy engine, its block) says */
+bool segmentsTile(struct snapshotSegment *segments, long count) {
+
+    long cursor = 0;
+    long i;
+    for (i = 0; i < count; i++) {
+        struct snapshotSegment *g = &segments[i];
+        if (g->start != cursor || g->size <= 0 || g->end < g->start || g->end >= current->bytes) {
+            return false;
+        }
+        if (g->strategy != 0 && (g->hole || !strchr("FBWNT", g->strategy))) {
+            return false;
+        }
+        if (mode == BUDDY) {
+            if (g->order < 0 || g->order >= BUDDY_ORDERS || g->start % (1L << g->order) != 0 ||
+                g->end != g->start + (1L << g->order) - 1 || g->size > 1L << g->order) {
+                return false;
+            }
+        } else if (g->end != g->start + g->size - 1) {
+            return false;
+        }
+        cursor = g->end + 1;
+    }
+
+    /* an empty arena has no segments until its first request */
+    return count == 0 || cursor == current->bytes;
+}
+
+/* rebuilds the current arena from its section of a mapped snapshot,
+   returning the end of the section, or NULL if it does not fit in
+   [at, limit) */
+char *restoreArena(char *at, char *limit) {
+
+    if (limit - at < (long) sizeof(struct snapshotArena)) {
+        return NULL;
+    }
+    struct snapshotArena *sa = (struct snapshotArena *) at;
+    at += sizeof(*sa);
+
+    if (sa->segments < 0 || sa->names < 0 || sa->text < 0 ||
+        sa->segments > (limit - at) / (long) sizeof(struct snapshotSegment)) {
+        return NULL;
+    }
+    struct snapshotSegment *segments = (struct snapshotSegment *) at;
+    at += sa->segments * sizeof(struct snapshotSegment);
+    if (!segmentsTile(segments, sa->segments)) {
+        return NULL;
+    }
+
+    if (sa->holes < 0 || sa->holes > (limit - at) / (long) sizeof(long)) {
+        return NULL;
+    }
+    long *holes = (long *) at;
+    at += sa->holes * sizeof(long);
+
+    if (sa->names > (limit - at) / (long) sizeof(struct snapshotName)) {
+        return NULL;
+    }
+    struct snapshotName *names = (struct snapshotName *) at;
+    at += sa->names * sizeof(struct snapshotName);
+
+    if (sa->text > limit - at || (sa->text > 0 && at[sa->text - 1] != '\0')) {
+        return NULL;
+    }
+    char *text = at;
+    at += sa->text;
+
+    /* every node at once, in a slab of exactly the right size */
+    long count = sa->segments;
+    struct slab *s = (struct slab *) malloc(sizeof(struct slab) + sizeof(struct node) * count);
+    s->next = current->slabs;
+    current->slabs = s;
+    struct node *nodes = s->nodes;
+
+    long i;
+    for (i = 0; i < count; i++) {
+        struct node *n = &nodes[i];
+        n->next = i > 0 ? &nodes[i - 1] : NULL;
+        n->prev = i + 1 < count ? &nodes[i + 1] : NULL;
+        n->name = "hole";
+        n->size = segments[i].size;
+        n->start = segments[i].start;
+        n->end = segments[i].end;
+        n->hole = segments[i].hole;
+        n->strategy = (char) segments[i].strategy;
+        n->order = segments[i].order;
+    }
+    current->tail = count > 0 ? &nodes[0] : NULL;
+    current->head = count > 0 ? &nodes[count - 1] : NULL;
+
+    /* the name table comes back the same size with every name in the
+       same slot, so nothing is hashed or probed */
+    if (sa->namecap < 0 || sa->namecap > 0x40000000 || (sa->namecap & (sa->namecap - 1)) ||
+        sa->names > sa->namecap) {
+        return NULL;
+    }
+    current->namecap = sa->namecap;
+    current->names = (struct name *) calloc(current->namecap, sizeof(struct name));
+
+    for (i = 0; i < sa->names; i++) {
+        struct snapshotName *r = &names[i];
+        if (r->text < 0 || r->text >= sa->text || r->segment >= count ||
+            r->slot < 0 || r->slot >= current->namecap) {
+            return NULL;
+        }
+
+        struct name *slot = &current->names[r->slot];
+        if (slot->str) {
+            return NULL; /* two names in one slot */
+        }
+        slot->str = text + r->text;
+        slot->hash = r->hash;
+        if (r->segment >= 0) {
+            slot->node = &nodes[r->segment];
+            nodes[r->segment].name = slot->str;
+        }
+        current->namecount++;
+    }
+
+    /* the segments are already in address order */
+    if (mode != TLSF && count > 0) {
+        avlBuild(&current->segments, &nodes[0].byaddr, sizeof(struct node), count);
+    }
+
+    /* a hole filed twice would be counted twice and break its index */
+    bool *filed = (bool *) calloc(count + 1, sizeof(bool));
+    for (i = 0; i < sa->holes; i++) {
+        /* segments are in address order, so search them for the start */
+        long low = 0;
+        long high = count - 1;
+        while (low < high) {
+            long middle = low + (high - low) / 2;
+            if (nodes[middle].start < holes[i]) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        struct node *n = &nodes[low];
+        if (count == 0 || n->start != holes[i] || !n->hole || filed[low]) {
+            free(filed);
+            return NULL;
+        }
+        filed[low] = true;
+        if (mode == BUDDY) {
+            pushFreeBlock(n);
+        } else {
+            indexHole(n);
+        }
+    }
+    free(filed);
+
+    /* the snapshot holds no bytes, so processes get their pattern again */
+    if (current->data) {
+        for (i = 0; i < count; i++) {
+            if (!nodes[i].hole) {
+                fillData(&nodes[i]);
+            }
+        }
+    }
+
+    current->allocated = sa->allocated;
+    current->buddies.reserved = sa->reserved;
+    current->rover = sa->rover >= 0 && sa->rover < count ? &nodes[sa->rover] : NULL;
+
+    return at;
+}
+
+int restoreSnapshot(char *path) {
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf(RED "\nCould not open snapshot %s.\n\n" END, path);
+        return -1;
+    }
+
+    /* the allocator's stat() hides the one from sys/stat.h */
+    off_t length = lseek(fd, 0, SEEK_END);
+    if (length < (off_t) sizeof(struct snapshotHeader)) {
+        printf(RED "\n%s is not a snapshot.\n\n" END, path);
+        close(fd);
+        return -1;
+    }
+
+    mappedLength = length;
+    mapped = mmap(NULL, mappedLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        mapped = NULL;
+        printf(RED "\nCould not map snapshot %s.\n\n" END, path);
+        return -1;
+    }
+
+    struct snapshotHeader *h = (struct snapshotHeader *) mapped;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 || h->version != SNAPSHOT_VERSION) {
+        printf(RED "\n%s is not a snapshot.\n\n" END, path);
+        return -1;
+    }
+    if (h->mode != (int) mode || h->bytes != bytes || h->arenas != arenaCount) {
+        printf(RED "\n%s was saved from %ld bytes in %ld arena(s) with the %s engine.\n\n" END, path,
+               h->bytes, h->arenas, h->mode == BUDDY ? "buddy" : h->mode == TLSF ? "tlsf" : "list");
+        return -1;
+    }
+
+    char *at = (char *) mapped + sizeof(*h);
+    char *limit = (char *) mapped + mappedLength;
+    int i;
+    for (i = 0; i < arenaCount && at; i++) {
+        current = &arenas[i];
+        at = restoreArena(at, limit);
+    }
+    current = &arenas[0];
+
+    if (!at) {
+        printf(RED "\nSnapshot %s is damaged.\n\n" END, path);
+        return -1;
+    }
+    return 0;
+}
+
+void unmapSnapshot() {
+
+    if (mapped) {
+        munmap(mapped, mappedLength);
+        mapped = NULL;
+    }
+}
@@ -0,0 +1,947 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "allocator.h"
+
+#define TABLE_CHUNK 1024 /* segments a chunk of the table holds */
+
+/* The table engine keeps an arena's segments in address order in chunks
+   of parallel arrays rather than in a list of nodes. Looking for a hole
+   reads nothing but hole sizes, eight bytes a segment one after another,
+   and skips every chunk whose largest hole is too small. A segment is
+   put in or taken out by moving the rest of its chunk along, and a full
+   chunk splits in two, so neither costs more than a chunk's worth */
+
+typedef struct chunk {
+    int count; /* segments in the chunk */
+    long largest; /* size of its largest hole, 0 if it has none */
+    long start[TABLE_CHUNK]; /* start address of each segment */
+    long size[TABLE_CHUNK]; /* bytes of each segment */
+    long free[TABLE_CHUNK]; /* bytes of each hole, 0 for a process */
+    char *name[TABLE_CHUNK]; /* interned name of each process, NULL for a hole */
+    char strategy[TABLE_CHUNK]; /* flag each process was placed with */
+} chunk;
+
+typedef struct position {
+    int chunk; /* index of the chunk in the table */
+    int index; /* index of the segment in the chunk */
+} position;
+
+struct chunk *chunkAt(struct position at) {
+
+    return current->table.chunks[at.chunk];
+}
+
+bool samePosition(struct position a, struct position b) {
+
+    return a.chunk == b.chunk && a.index == b.index;
+}
+
+/* moves count segments of one chunk to another (or the same) chunk */
+void moveSegments(struct chunk *to, int at, struct chunk *from, int first, int count) {
+
+    memmove(&to->start[at], &from->start[first], sizeof(long) * count);
+    memmove(&to->size[at], &from->size[first], sizeof(long) * count);
+    memmove(&to->free[at], &from->free[first], sizeof(long) * count);
+    memmove(&to->name[at], &from->name[first], sizeof(char *) * count);
+    memmove(&to->strategy[at], &from->strategy[first], count);
+}
+
+void measureChunk(struct chunk *k) {
+
+    k->largest = scan.largest(k->free, k->count);
+}
+
+/* sets the hole bytes of a segment, keeping its chunk's largest hole */
+void setFree(struct chunk *k, int i, long free) {
+
+    long old = k->free[i];
+    k->free[i] = free;
+    if (free > k->largest) {
+        k->largest = free;
+    } else if (old == k->largest && free < old) {
+        measureChunk(k);
+    }
+}
+
+/* counts a hole in / out of the arena's counters, as indexHole and
+   unindexHole do for the list */
+void countHole(long size) {
+
+    current->freeBytes += size;
+    current->holeCount++;
+    if (current->largest >= 0 && size > current->largest) {
+        current->largest = size;
+    }
+}
+
+void uncountHole(long size) {
+
+    current->freeBytes -= size;
+    current->holeCount--;
+    if (size == current->largest) {
+        current->largest = -1; /* looked up again when next needed */
+    }
+}
+
+/* next fit resumes from a segment, so the rover follows its start */
+void moveRover(long from, long to) {
+
+    if (current->table.rover == from) {
+        current->table.rover = to;
+    }
+}
+
+void insertChunk(int at, struct chunk *k) {
+
+    struct table *t = &current->table;
+    if (t->count == t->capacity) {
+        t->capacity = t->capacity ? t->capacity * 2 : 16;
+        t->chunks = (struct chunk **) realloc(t->chunks, sizeof(struct chunk *) * t->capacity);
+    }
+    memmove(&t->chunks[at + 1], &t->chunks[at], sizeof(struct chunk *) * (t->count - at));
+    t->chunks[at] = k;
+    t->count++;
+}
+
+void removeChunk(int at) {
+
+    struct table *t = &current->table;
+    free(t->chunks[at]);
+    memmove(&t->chunks[at], &t->chunks[at + 1], sizeof(struct chunk *) * (t->count - at - 1));
+    t->count--;
+}
+
+/* puts a segment in before the one at a position (or after the last of
+   its chunk), leaving the position at the new segment */
+void insertSegment(struct position *at, long start, long size, char *name /* NULL for a hole */, char strategy) {
+
+    struct chunk *k = chunkAt(*at);
+
+    if (k->count == TABLE_CHUNK) {
+        /* a full chunk hands its upper half to a new one */
+        int half = TABLE_CHUNK / 2;
+        struct chunk *upper = (struct chunk *) malloc(sizeof(struct chunk));
+        moveSegments(upper, 0, k, half, TABLE_CHUNK - half);
+        upper->count = TABLE_CHUNK - half;
+        k->count = half;
+        measureChunk(k);
+        measureChunk(upper);
+        insertChunk(at->chunk + 1, upper);
+
+        if (at->index > half) {
+            at->chunk++;
+            at->index -= half;
+            k = upper;
+        }
+    }
+
+    int i = at->index;
+    moveSegments(k, i + 1, k, i, k->count - i);
+    k->count++;
+    k->start[i] = start;
+    k->size[i] = size;
+    k->free[i] = name ? 0 : size;
+    k->name[i] = name;
+    k->strategy[i] = strategy;
+    if (k->free[i] > k->largest) {
+        k->largest = k->free[i];
+    }
+}
+
+/* a chunk that has emptied out joins a neighbour once both fit in half a
+   chunk, so scans do not crawl through slivers */
+void tidyChunk(int c) {
+
+    struct table *t = &current->table;
+    int half = TABLE_CHUNK / 2;
+
+    /* merge into the chunk below if it has room, else take in the one above */
+    if (c > 0 && c < t->count && t->chunks[c - 1]->count + t->chunks[c]->count <= half) {
+        c--;
+    } else if (c + 1 >= t->count || t->chunks[c]->count + t->chunks[c + 1]->count > half) {
+        return;
+    }
+
+    struct chunk *low = t->chunks[c];
+    struct chunk *high = t->chunks[c + 1];
+    moveSegments(low, low->count, high, 0, high->count);
+    low->count += high->count;
+    if (high->largest > low->largest) {
+        low->largest = high->largest;
+    }
+    removeChunk(c + 1);
+}
+
+/* takes count segments out from a position on, over as many chunks as
+   they span */
+void removeSegments(struct position at, long count) {
+
+    while (count > 0) {
+        struct chunk *k = chunkAt(at);
+        int n = count < k->count - at.index ? (int) count : k->count - at.index;
+        moveSegments(k, at.index, k, at.index + n, k->count - at.index - n);
+        k->count -= n;
+        count -= n;
+
+        if (k->count == 0) {
+            removeChunk(at.chunk);
+        } else {
+            measureChunk(k);
+            if (count > 0) {
+                at.chunk++;
+            }
+        }
+        at.index = 0;
+    }
+
+    tidyChunk(at.chunk);
+}
+
+/* returns the position of the segment holding an address */
+struct position locate(long address) {
+
+    struct table *t = &current->table;
+
+    /* the last chunk, then the last segment, starting at or below it */
+    int low = 0;
+    int high = t->count - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (t->chunks[middle]->start[0] <= address) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    struct chunk *k = t->chunks[low];
+    int first = 0;
+    int last = k->count - 1;
+    while (first < last) {
+        int middle = (first + last + 1) / 2;
+        if (k->start[middle] <= address) {
+            first = middle;
+        } else {
+            last = middle - 1;
+        }
+    }
+
+    return (struct position) { low, first };
+}
+
+/* moves a position to the segment above / below it, returning false
+   (and leaving it be) if there is none */
+bool nextSegment(struct position *at) {
+
+    if (at->index + 1 < chunkAt(*at)->count) {
+        at->index++;
+    } else if (at->chunk + 1 < current->table.count) {
+        at->chunk++;
+        at->index = 0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool previousSegment(struct position *at) {
+
+    if (at->index > 0) {
+        at->index--;
+    } else if (at->chunk > 0) {
+        at->chunk--;
+        at->index = chunkAt(*at)->count - 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool holeAt(struct position at) {
+
+    return chunkAt(at)->free[at.index] > 0;
+}
+
+/* finds the first hole of at least size bytes from one position up to,
+   but not including, another */
+bool firstHole(long size, struct position from, struct position to, struct position *found) {
+
+    struct table *t = &current->table;
+    int c;
+    for (c = from.chunk; c <= to.chunk && c < t->count; c++) {
+        struct chunk *k = t->chunks[c];
+        if (k->largest < size) {
+            continue;
+        }
+
+        int i = c == from.chunk ? from.index : 0;
+        int end = c == to.chunk ? to.index : k->count;
+        if (i < end) {
+            int fit = scan.firstFitting(&k->free[i], end - i, size);
+            if (fit >= 0) {
+                *found = (struct position) { c, i + fit };
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* finds the smallest hole of at least size bytes, the lowest if several are */
+bool bestHole(long size, struct position *found) {
+
+    struct table *t = &current->table;
+    long best = 0;
+    int c;
+    for (c = 0; c < t->count; c++) {
+        struct chunk *k = t->chunks[c];
+        if (k->largest < size) {
+            continue;
+        }
+
+        /* the chunk holds a fitting hole, since its largest does */
+        int i = scan.smallestFitting(k->free, k->count, size);
+        long hole = k->free[i];
+        if (!best || hole < best) {
+            best = hole;
+            *found = (struct position) { c, i };
+            if (hole == size) {
+                return true;
+            }
+        }
+    }
+    return best > 0;
+}
+
+/* finds the largest hole, the lowest if several are */
+bool worstHole(long size, struct position *found) {
+
+    struct table *t = &current->table;
+    long largest = 0;
+    int best = 0;
+    int c;
+    for (c = 0; c < t->count; c++) {
+        if (t->chunks[c]->largest > largest) {
+            largest = t->chunks[c]->largest;
+            best = c;
+        }
+    }
+
+    if (largest < size) {
+        return false;
+    }
+
+    struct chunk *k = t->chunks[best];
+    *found = (struct position) { best, scan.firstFitting(k->free, k->count, largest) };
+    return true;
+}
+
+/* places a process at the low end of a hole, returning its start and
+   leaving the position at the process */
+long placeInHole(struct position *at, char *name, long size, char strategy) {
+
+    struct chunk *k = chunkAt(*at);
+    int i = at->index;
+    long start = k->start[i];
+    long hole = k->free[i];
+
+    uncountHole(hole);
+    if (hole == size) {
+        k->name[i] = name;
+        k->strategy[i] = strategy;
+        setFree(k, i, 0);
+    } else {
+        k->start[i] += size;
+        k->size[i] -= size;
+        setFree(k, i, hole - size);
+        countHole(hole - size);
+        if (tracing) {
+            recordEvent(HAPPENED_SPLIT, start, size, hole - size);
+        }
+
+        moveRover(start, start + size);
+        insertSegment(at, start, size, name, strategy);
+    }
+
+    return start;
+}
+
+/* finds a hole by a strategy flag and places a process in it, returning
+   its start or -1 if no hole is large enough */
+long placeInTable(char *name, long size, char flag) {
+
+    struct table *t = &current->table;
+
+    if (t->count == 0) {
+        if (size > current->bytes) {
+            return -1;
+        }
+        /* memory nobody has asked for yet becomes one hole */
+        struct chunk *k = (struct chunk *) malloc(sizeof(struct chunk));
+        k->count = 0;
+        k->largest = 0;
+        insertChunk(0, k);
+        struct position at = { 0, 0 };
+        insertSegment(&at, 0, current->bytes, NULL, 0);
+        countHole(current->bytes);
+    }
+
+    struct position begin = { 0, 0 };
+    struct position end = { t->count, 0 };
+    struct position at;
+    bool found;
+
+    if (flag == 'W') {
+        found = worstHole(size, &at);
+    } else if (flag == 'B' || flag == 'T') {
+        found = bestHole(size, &at);
+    } else if (flag == 'N') {
+        /* resume where the last process was placed and wrap around */
+        struct position rover = t->rover < 0 ? begin : locate(t->rover);
+        found = firstHole(size, rover, end, &at) || firstHole(size, begin, rover, &at);
+    } else {
+        found = firstHole(size, begin, end, &at);
+    }
+
+    if (!found) {
+        return -1;
+    }
+
+    long start = placeInHole(&at, name, size, flag);
+    if (flag == 'N') {
+        t->rover = start;
+    }
+    return start;
+}
+
+/* places a process in the position of a hole for walkTable */
+void placeWalked(struct position *at, struct node *p, char flag) {
+
+    long start = placeInHole(at, p->name, p->size, flag);
+    if (flag == 'N') {
+        current->table.rover = start;
+    }
+    findName(p->name)->start = start;
+    p->start = start;
+    p->end = start + p->size - 1;
+    processCreated(p);
+}
+
+void walkTable(struct node **processes, bool *placed, int count, char flag) {
+
+    struct table *t = &current->table;
+    int first = 0; /* the largest process not yet placed */
+    int last = count - 1; /* the smallest */
+    while (first <= last && !processes[first]) {
+        first++;
+    }
+    while (last >= first && !processes[last]) {
+        last--;
+    }
+    if (first > last) {
+        return;
+    }
+
+    struct position begin = { 0, 0 };
+    if (t->count == 0) {
+        int i;
+        for (i = first; i <= last && (!processes[i] || processes[i]->size > current->bytes); i++) {
+        }
+        if (i > last) {
+            return;
+        }
+        /* memory nobody has asked for yet becomes one hole */
+        struct chunk *k = (struct chunk *) malloc(sizeof(struct chunk));
+        k->count = 0;
+        k->largest = 0;
+        insertChunk(0, k);
+        struct position hole = begin;
+        insertSegment(&hole, 0, current->bytes, NULL, 0);
+        countHole(current->bytes);
+        hole = begin;
+        placeWalked(&hole, processes[i], flag);
+        placed[i] = true;
+    }
+
+    struct position at = flag == 'N' && t->rover >= 0 ? locate(t->rover) : begin;
+    long from = chunkAt(at)->start[at.index]; /* where the walk stops once it wraps */
+    bool wrapped = false;
+
+    while (first <= last) {
+        struct chunk *k = chunkAt(at);
+        long smallest = processes[last]->size;
+
+        if (k->largest < smallest) {
+            /* nothing in the chunk fits, so go on from its last segment */
+            at.index = k->count - 1;
+        } else if (k->free[at.index] >= smallest) {
+            int i;
+            for (i = first; i <= last && holeAt(at); i++) {
+                if (placed[i] || !processes[i] || processes[i]->size > chunkAt(at)->free[at.index]) {
+                    continue;
+                }
+                bool used = processes[i]->size == chunkAt(at)->free[at.index];
+                placeWalked(&at, processes[i], flag);
+                placed[i] = true;
+                if (!used) {
+                    nextSegment(&at); /* the rest of the hole, above the process */
+                }
+            }
+            while (first <= last && (placed[first] || !processes[first])) {
+                first++;
+            }
+            while (last >= first && (placed[last] || !processes[last])) {
+                last--;
+            }
+        }
+
+        if (!nextSegment(&at)) {
+            if (flag != 'N' || wrapped) {
+                break;
+            }
+            at = begin;
+            wrapped = true;
+        }
+        if (wrapped && chunkAt(at)->start[at.index] >= from) {
+            break;
+        }
+    }
+}
+
+int tableFit(struct node *p, char flag) {
+
+    long start = placeInTable(p->name, p->size, flag);
+    if (start < 0) {
+        return -1;
+    }
+
+    findName(p->name)->start = start;
+    p->start = start;
+    p->end = start + p->size - 1;
+    processCreated(p);
+
+    /* the table keeps no nodes, so the one that carried the request
+       goes back to the pool */
+    putNode(p);
+    return 0;
+}
+
+/* merges the hole at high into the hole right below it at low */
+void joinHoles(struct position low, struct position high) {
+
+    struct chunk *l = chunkAt(low);
+    struct chunk *h = chunkAt(high);
+
+    uncountHole(l->free[low.index]);
+    uncountHole(h->free[high.index]);
+    moveRover(h->start[high.index], l->start[low.index]);
+    l->size[low.index] += h->size[high.index];
+    setFree(l, low.index, l->size[low.index]);
+    countHole(l->size[low.index]);
+    if (tracing) {
+        recordEvent(HAPPENED_COALESCE, l->start[low.index], l->size[low.index], 2);
+    }
+
+    removeSegments(high, 1);
+}
+
+/* turns the process starting at an address into a hole, merged with the
+   holes on either side of it */
+void freeSegment(long start) {
+
+    struct position at = locate(start);
+    struct chunk *k = chunkAt(at);
+    k->name[at.index] = NULL;
+    setFree(k, at.index, k->size[at.index]);
+    countHole(k->size[at.index]);
+
+    struct position above = at;
+    if (nextSegment(&above) && holeAt(above)) {
+        joinHoles(at, above);
+    }
+
+    /* merging may have moved segments between chunks, so look again */
+    at = locate(start);
+    struct position below = at;
+    if (previousSegment(&below) && holeAt(below)) {
+        joinHoles(below, at);
+    }
+}
+
+long releaseInTable(struct name *entry) {
+
+    struct position at = locate(entry->start);
+    long size = chunkAt(at)->size[at.index];
+
+    current->allocated -= size;
+    totals.released++;
+    if (tracing) {
+        recordEvent(HAPPENED_RELEASE, entry->start, size, 0);
+    }
+    freeSegment(entry->start);
+    entry->start = -1;
+    return size;
+}
+
+/* finds the arena holding a name, looking where the process would have
+   gone first, and leaves it locked and current- NULL if none has it */
+struct name *findInArenas(char *name) {
+
+    struct name *entry = NULL;
+    int home = homeArena(name);
+    int i;
+    for (i = 0; i < arenaCount && !entry; i++) {
+        struct arena *a = &arenas[(home + i) % arenaCount];
+        lockArena(a);
+        current = a;
+        entry = findName(name);
+        if (!entry) {
+            unlockArena(a);
+        }
+    }
+    return entry;
+}
+
+int tableRelease(char *name) {
+
+    struct name *entry = findInArenas(name);
+
+    if (!entry) {
+        report(RED "\nProcess %s not located in memory.\n\n" END, name);
+        return -1;
+    }
+
+    if (entry->start < 0) {
+        report(YEL "\nProcess %s has already been released from memory.\n\n" END, name);
+    } else {
+        long size = releaseInTable(entry);
+        report(PUR "\nProcess %s released from memory (%ld bytes).\n\n" END, entry->str, size);
+        compactAfterRelease();
+    }
+
+    unlockArena(current);
+    return 0;
+}
+
+/* resizes the process at a position without moving it, shrinking into /
+   growing out of the hole above it- returns -1 if it cannot */
+int resizeInTable(struct position at, long size) {
+
+    struct chunk *k = chunkAt(at);
+    long difference = size - k->size[at.index];
+    long end = k->start[at.index] + size;
+    struct position above = at;
+    bool hole = nextSegment(&above) && holeAt(above);
+
+    if (difference > 0 && (!hole || chunkAt(above)->free[above.index] < difference)) {
+        return -1;
+    }
+
+    /* the process takes its new size before anything around it moves */
+    k->size[at.index] = size;
+    current->allocated += difference;
+
+    if (hole && difference != 0) {
+        struct chunk *h = chunkAt(above);
+        long remaining = h->free[above.index] - difference;
+        uncountHole(h->free[above.index]);
+        if (remaining == 0) {
+            /* the hole disappears into the process */
+            moveRover(h->start[above.index], k->start[at.index]);
+            removeSegments(above, 1);
+        } else {
+            moveRover(h->start[above.index], end);
+            h->start[above.index] = end;
+            h->size[above.index] = remaining;
+            setFree(h, above.index, remaining);
+            countHole(remaining);
+        }
+    } else if (difference < 0) {
+        /* the freed tail becomes a hole of its own */
+        at.index++;
+        insertSegment(&at, end, -difference, NULL, 0);
+        countHole(-difference);
+    }
+
+    return 0;
+}
+
+int tableResize(char *name, long size, char flag) {
+
+    struct name *entry = findInArenas(name);
+
+    if (!entry || entry->start < 0) {
+        report(RED "\nProcess %s is not in memory.\n\n" END, name);
+        if (entry) {
+            unlockArena(current);
+        }
+        return -1;
+    }
+
+    struct position at = locate(entry->start);
+    long oldSize = chunkAt(at)->size[at.index];
+    char strategy = chunkAt(at)->strategy[at.index];
+
+    if (resizeInTable(at, size) == 0) {
+        totals.resized++;
+        report(GRN "\nProcess %s resized in place from %ld to %ld bytes.\n\n" END, name, oldSize, size);
+        unlockArena(current);
+        return 0;
+    }
+
+    /* like realloc, the new place is found while the old one is still
+       taken, so a failed move leaves the process as it was */
+    flag = flag ? flag : strategy ? strategy : 'F';
+    long from = entry->start;
+    long start = placeInTable(entry->str, size, flag);
+    if (start < 0) {
+        totals.resizeFailed++;
+        report(RED "\nNot enough memory is available to resize process %s to %ld bytes.\n\n" END, name, size);
+        unlockArena(current);
+        return -1;
+    }
+
+    report(GRN "\nProcess %s moved from %ld to %ld to be resized from %ld bytes.\n\n" END, entry->str,
+           current->base + from, current->base + start, oldSize);
+
+    if (tracing) {
+        recordEvent(HAPPENED_RESIZE, start, size, from);
+    }
+    entry->start = start;
+    freeSegment(from);
+    current->allocated += size - oldSize;
+    totals.relocated++;
+
+    unlockArena(current);
+    return 0;
+}
+
+/* moves the processes from first to last (first at the lowest address)
+   down against each other, leaving the free bytes as one hole on top-
+   returns the bytes moved */
+long slideTable(struct position first, struct position last) {
+
+    struct table *t = &current->table;
+    struct position read = first;
+    struct position write = first; /* where the next process kept goes */
+    long cursor = chunkAt(first)->start[first.index];
+    long rover = t->rover;
+    bool roverRemoved = false;
+    long freeBytes = 0;
+    long moved = 0;
+    long removed = 0; /* segments read and not written back */
+
+    while (true) {
+        struct chunk *r = chunkAt(read);
+        int i = read.index;
+        bool holdsRover = t->rover == r->start[i];
+
+        if (r->free[i] > 0) {
+            freeBytes += r->free[i];
+            uncountHole(r->free[i]);
+            roverRemoved = roverRemoved || holdsRover;
+            removed++;
+        } else {
+            if (r->start[i] != cursor) {
+                moved += r->size[i];
+                if (tracing) {
+                    recordEvent(HAPPENED_MOVE, cursor, r->size[i], r->start[i]);
+                }
+                findName(r->name[i])->start = cursor;
+            }
+            if (holdsRover) {
+                rover = cursor;
+            }
+
+            /* everything below the write position has been read */
+            struct chunk *w = chunkAt(write);
+            w->start[write.index] = cursor;
+            w->size[write.index] = r->size[i];
+            w->free[write.index] = 0;
+            w->name[write.index] = r->name[i];
+            w->strategy[write.index] = r->strategy[i];
+            cursor += r->size[i];
+
+            if (++write.index == w->count && write.chunk + 1 < t->count) {
+                write.chunk++;
+                write.index = 0;
+            }
+        }
+
+        if (samePosition(read, last)) {
+            break;
+        }
+        nextSegment(&read);
+    }
+
+    /* the free bytes become one hole on top, merged with the hole above
+       if there is one */
+    struct position above = last;
+    if (freeBytes > 0) {
+        if (nextSegment(&above) && holeAt(above)) {
+            struct chunk *h = chunkAt(above);
+            uncountHole(h->free[above.index]);
+            if (rover == h->start[above.index]) {
+                rover = cursor;
+            }
+            h->start[above.index] = cursor;
+            h->size[above.index] += freeBytes;
+            h->free[above.index] = h->size[above.index];
+            countHole(h->size[above.index]);
+        } else {
+            struct chunk *w = chunkAt(write);
+            w->start[write.index] = cursor;
+            w->size[write.index] = freeBytes;
+            w->free[write.index] = freeBytes;
+            w->name[write.index] = NULL;
+            w->strategy[write.index] = 0;
+            countHole(freeBytes);
+            removed--;
+
+            if (++write.index == w->count && write.chunk + 1 < t->count) {
+                write.chunk++;
+                write.index = 0;
+            }
+        }
+    }
+
+    /* next fit carries on from the hole that replaced its position */
+    t->rover = roverRemoved ? cursor : rover;
+
+    int c;
+    for (c = first.chunk; c <= write.chunk && c < t->count; c++) {
+        measureChunk(t->chunks[c]);
+    }
+    removeSegments(write, removed);
+
+    return moved;
+}
+
+long tableCompact() {
+
+    struct table *t = &current->table;
+    if (t->count == 0) {
+        return 0;
+    }
+
+    /* processes below the lowest hole are already in place */
+    struct position begin = { 0, 0 };
+    struct position end = { t->count, 0 };
+    struct position first;
+    if (!firstHole(1, begin, end, &first)) {
+        return 0;
+    }
+
+    struct position last = { t->count - 1, t->chunks[t->count - 1]->count - 1 };
+    if (samePosition(first, last)) {
+        return 0;
+    }
+    return slideTable(first, last);
+}
+
+long tableCompactUntil(long size) {
+
+    if (current->table.count == 0) {
+        return 0;
+    }
+
+    /* the same two pointers compactUntil runs over the list */
+    struct position i = { 0, 0 };
+    struct position j = { 0, 0 };
+    struct position bestFirst = i;
+    struct position bestLast = i;
+    bool found = false;
+    long freeBytes = 0;
+    long used = 0;
+    long bestUsed = 0;
+
+    do {
+        struct chunk *k = chunkAt(j);
+        if (k->free[j.index] > 0) {
+            freeBytes += k->size[j.index];
+        } else {
+            used += k->size[j.index];
+        }
+
+        while (!samePosition(i, j)) {
+            struct chunk *b = chunkAt(i);
+            long hole = b->free[i.index];
+            if (freeBytes - hole < size) {
+                break;
+            }
+            if (hole > 0) {
+                freeBytes -= hole;
+            } else {
+                used -= b->size[i.index];
+            }
+            nextSegment(&i);
+        }
+
+        if (freeBytes >= size && (!found || used < bestUsed)) {
+            bestFirst = i;
+            bestLast = j;
+            bestUsed = used;
+            found = true;
+        }
+    } while (nextSegment(&j));
+
+    if (found && !samePosition(bestFirst, bestLast)) {
+        return slideTable(bestFirst, bestLast);
+    }
+    return 0;
+}
+
+long tableLargest() {
+
+    struct table *t = &current->table;
+    long largest = 0;
+    int c;
+    for (c = 0; c < t->count; c++) {
+        if (t->chunks[c]->largest > largest) {
+            largest = t->chunks[c]->largest;
+        }
+    }
+    return largest;
+}
+
+void printTable(long first, long last) {
+
+    struct table *t = &current->table;
+    if (t->count == 0) {
+        printSegment(NULL);
+        return;
+    }
+
+    struct position at = locate(first);
+    do {
+        struct chunk *k = chunkAt(at);
+        int i = at.index;
+        if (k->start[i] > last) {
+            break;
+        }
+
+        /* printSegment formats nodes, so lend it one */
+        struct node n = { 0 };
+        n.name = k->name[i] ? k->name[i] : "hole";
+        n.size = k->size[i];
+        n.start = k->start[i];
+        n.end = k->start[i] + k->size[i] - 1;
+        n.hole = k->free[i] > 0;
+        printSegment(&n);
+    } while (nextSegment(&at));
+}
+
+void freeTable() {
+
+    struct table *t = &current->table;
+    int c;
+    for (c = 0; c < t->count; c++) {
+        free(t->chunks[c]);
+    }
+    free(t->chunks);
+    memset(t, 0, sizeof(*t));
+    t->rover = -1;
+}
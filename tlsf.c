@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "allocator.h"
+
+void sizeClass(long size, int *fl, int *sl) {
+
+    if (size < SL_COUNT) {
+        /* small holes get a class of their own per size */
+        *fl = 0;
+        *sl = (int) size;
+    } else {
+        /* the highest set bit picks the first level, the bits below it
+           split that power of two into SL_COUNT equal classes */
+        int f = 63 - __builtin_clzl(size);
+        *fl = f - SL_LOG2 + 1;
+        *sl = (int) (size >> (f - SL_LOG2)) - SL_COUNT;
+    }
+}
+
+void binHole(struct node *n) {
+
+    struct segregated *classes = &current->classes;
+    int fl, sl;
+    sizeClass(n->size, &fl, &sl);
+
+    n->prevFree = NULL;
+    n->nextFree = classes->bins[fl][sl];
+    if (classes->bins[fl][sl]) {
+        classes->bins[fl][sl]->prevFree = n;
+    }
+    classes->bins[fl][sl] = n;
+
+    classes->slBitmap[fl] |= 1u << sl;
+    classes->flBitmap |= 1UL << fl;
+}
+
+void unbinHole(struct node *n) {
+
+    struct segregated *classes = &current->classes;
+    int fl, sl;
+    sizeClass(n->size, &fl, &sl);
+
+    if (n->prevFree) {
+        n->prevFree->nextFree = n->nextFree;
+    } else {
+        classes->bins[fl][sl] = n->nextFree;
+    }
+    if (n->nextFree) {
+        n->nextFree->prevFree = n->prevFree;
+    }
+
+    if (!classes->bins[fl][sl]) {
+        classes->slBitmap[fl] &= ~(1u << sl);
+        if (!classes->slBitmap[fl]) {
+            classes->flBitmap &= ~(1UL << fl);
+        }
+    }
+}
+
+struct node *segregatedHole(long size) {
+
+    /* nothing larger than memory is ever free, and rounding it up could
+       overflow */
+    if (size > current->bytes) {
+        return NULL;
+    }
+
+    /* round up to the next class boundary so that any hole of the
+       class found is large enough, with no search inside the class */
+    long rounded = size;
+    if (size >= SL_COUNT) {
+        rounded += (1L << (63 - __builtin_clzl(size) - SL_LOG2)) - 1;
+    }
+
+    struct segregated *classes = &current->classes;
+    int fl, sl;
+    sizeClass(rounded, &fl, &sl);
+
+    unsigned slMap = classes->slBitmap[fl] & (~0u << sl);
+    if (!slMap) {
+        unsigned long flMap = fl + 1 < FL_COUNT ? classes->flBitmap & (~0UL << (fl + 1)) : 0;
+        if (!flMap) {
+            return NULL;
+        }
+        fl = __builtin_ctzl(flMap);
+        slMap = classes->slBitmap[fl];
+    }
+    sl = __builtin_ctz(slMap);
+
+    return classes->bins[fl][sl];
+}
+
+int tlsfFit(struct node *p /* a process with only a name and size */) {
+
+    if (!current->head) {
+        if (allocateIntoEmptyMemory(p) < 0) {
+            return -1;
+        }
+    } else {
+        node *hole = segregatedHole(p->size);
+
+        if (hole) {
+            allocateProcessIntoHole(hole, p);
+        } else {
+            return -1;
+        }
+    }
+
+    processCreated(p);
+    return 0;
+}
@@ -0,0 +1,530 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "allocator.h"
+
+#define TRACE_MAGIC "ALLOCTRC"
+#define TRACE_VERSION 1
+
+/* A binary trace is a header, then one fixed-width record per command,
+   then the offset of every name in the text, then the text of the names.
+   Records refer to names by id, so each name is read once per replay */
+
+typedef struct traceHeader {
+    char magic[8]; /* TRACE_MAGIC, without a terminator */
+    int version; /* TRACE_VERSION */
+    int unused; /* padding, written as 0 */
+    long records; /* records after the header */
+    long names; /* name offsets after the records */
+    long text; /* bytes of name text after the offsets */
+} traceHeader;
+
+typedef enum traceOp {
+    TRACE_REQUEST, /* RQ name size strategy */
+    TRACE_RELEASE, /* RL name */
+    TRACE_COMPACT, /* C */
+    TRACE_STAT, /* STAT */
+    TRACE_STATS, /* STATS */
+    TRACE_RESIZE, /* RS name size [strategy], the strategy 0 if not given */
+    TRACE_LATENCY /* LATENCY */
+} traceOp;
+
+typedef struct traceRecord {
+    unsigned char op; /* a traceOp */
+    char strategy; /* F, B, W, N or T for requests */
+    short unused; /* padding, written as 0 */
+    unsigned name; /* id of the process name */
+    long size; /* bytes requested */
+} traceRecord;
+
+typedef struct traceJob {
+    int id; /* index of the worker */
+    struct traceRecord *records; /* the whole trace */
+    char **names; /* every name, by id */
+    long *mine; /* indexes of the records this worker runs, in order */
+    long count; /* number of records this worker runs */
+    struct instance memory; /* the memory the worker replays into */
+    struct summary totals; /* what the worker did */
+} traceJob;
+
+/* the ids handed out while converting, in an open-addressed table */
+typedef struct traceName {
+    char *str; /* the name, NULL if the slot is empty */
+    unsigned id; /* id given to the name */
+} traceName;
+
+/* a whole trace in memory, either mapped from a binary file or parsed
+   from text, ready to be replayed any number of times */
+typedef struct trace {
+    struct traceRecord *records; /* every command */
+    long count; /* number of records */
+    char **names; /* every name, by id */
+    long nameCount; /* number of names */
+    struct traceName *table; /* the names of a text trace, which own them */
+    long capacity; /* slots in table */
+    void *mapped; /* the mapping of a binary trace, NULL for text */
+    long length; /* bytes mapped */
+} trace;
+
+/* returns the id of a name, giving it the next one if it is new */
+unsigned nameId(struct traceName **table, long *capacity, long *count, char *name) {
+
+    if ((*count + 1) * 4 > *capacity * 3) {
+        struct traceName *old = *table;
+        long oldcap = *capacity;
+        *capacity = *capacity ? *capacity * 2 : 1024;
+        *table = (struct traceName *) calloc(*capacity, sizeof(struct traceName));
+
+        long i;
+        for (i = 0; i < oldcap; i++) {
+            if (old[i].str) {
+                long j = hashName(old[i].str) & (*capacity - 1);
+                while ((*table)[j].str) {
+                    j = (j + 1) & (*capacity - 1);
+                }
+                (*table)[j] = old[i];
+            }
+        }
+        free(old);
+    }
+
+    long j = hashName(name) & (*capacity - 1);
+    while ((*table)[j].str) {
+        if (strcmp((*table)[j].str, name) == 0) {
+            return (*table)[j].id;
+        }
+        j = (j + 1) & (*capacity - 1);
+    }
+
+    (*table)[j].str = strdup(name);
+    (*table)[j].id = (unsigned) (*count)++;
+    return (*table)[j].id;
+}
+
+/* turns one command of a text trace into a record- returns 1 if it has
+   one, 0 for a blank line and -1 for a command the binary format has no
+   record for */
+int parseCommand(struct command *c, struct traceRecord *r, struct traceName **table, long *capacity, long *count) {
+
+    if (c->count == 0) {
+        return 0;
+    }
+
+    memset(r, 0, sizeof(*r));
+    long size;
+    char flag = 0;
+
+    if (isCommand(c, "RQ") && c->count == 4 && parseNumber(c->words[2], &size) && size > 0 &&
+        parseStrategy(c->words[3], &flag)) {
+        r->op = TRACE_REQUEST;
+        r->strategy = flag;
+        r->name = nameId(table, capacity, count, c->words[1]);
+        r->size = size;
+    } else if (isCommand(c, "RS") && (c->count == 3 || (c->count == 4 && parseStrategy(c->words[3], &flag))) &&
+               parseNumber(c->words[2], &size) && size > 0) {
+        r->op = TRACE_RESIZE;
+        r->strategy = flag;
+        r->name = nameId(table, capacity, count, c->words[1]);
+        r->size = size;
+    } else if (isCommand(c, "RL") && c->count == 2) {
+        r->op = TRACE_RELEASE;
+        r->name = nameId(table, capacity, count, c->words[1]);
+    } else if (c->count > 1) {
+        return -1;
+    } else if (isCommand(c, "C")) {
+        r->op = TRACE_COMPACT;
+    } else if (isCommand(c, "STAT")) {
+        r->op = TRACE_STAT;
+    } else if (isCommand(c, "STATS")) {
+        r->op = TRACE_STATS;
+    } else if (isCommand(c, "LATENCY")) {
+        r->op = TRACE_LATENCY;
+    } else {
+        return -1;
+    }
+
+    return 1;
+}
+
+int convertTrace(char *from, char *to) {
+
+    FILE *in = fopen(from, "r");
+    if (!in) {
+        printf("Could not open trace %s.\n", from);
+        return -1;
+    }
+    FILE *out = fopen(to, "wb");
+    if (!out) {
+        printf("Could not open %s.\n", to);
+        fclose(in);
+        return -1;
+    }
+
+    /* the counts are only known at the end, so the header is written
+       again once they are */
+    struct traceHeader h = { { 0 } };
+    memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+    h.version = TRACE_VERSION;
+    fwrite(&h, sizeof(h), 1, out);
+
+    struct traceName *table = NULL;
+    long capacity = 0;
+    long skipped = 0;
+
+    struct reader *lines = openReader(in);
+    char *line;
+    while ((line = readLine(lines))) {
+        struct command c;
+        splitCommand(line, &c);
+        if (isQuit(&c)) {
+            break;
+        }
+
+        struct traceRecord r;
+        int parsed = parseCommand(&c, &r, &table, &capacity, &h.names);
+        if (parsed < 0) {
+            skipped++;
+        }
+        if (parsed <= 0) {
+            continue;
+        }
+
+        fwrite(&r, sizeof(r), 1, out);
+        h.records++;
+    }
+    closeReader(lines);
+
+    /* names in id order: first the offsets, then the text */
+    char **byId = (char **) malloc(sizeof(char *) * (h.names + 1));
+    long i;
+    for (i = 0; i < capacity; i++) {
+        if (table[i].str) {
+            byId[table[i].id] = table[i].str;
+        }
+    }
+    for (i = 0; i < h.names; i++) {
+        fwrite(&h.text, sizeof(h.text), 1, out);
+        h.text += strlen(byId[i]) + 1;
+    }
+    for (i = 0; i < h.names; i++) {
+        fwrite(byId[i], strlen(byId[i]) + 1, 1, out);
+    }
+
+    fseek(out, 0, SEEK_SET);
+    fwrite(&h, sizeof(h), 1, out);
+
+    bool failed = ferror(out);
+    failed = fclose(out) != 0 || failed;
+    fclose(in);
+
+    for (i = 0; i < capacity; i++) {
+        free(table[i].str);
+    }
+    free(table);
+    free(byId);
+
+    if (failed) {
+        printf("Could not write %s.\n", to);
+        return -1;
+    }
+
+    printf("Converted %ld commands naming %ld processes", h.records, h.names);
+    if (skipped) {
+        printf(", skipping %ld the binary format has no record for", skipped);
+    }
+    printf(".\n");
+    return 0;
+}
+
+/* returns true if a record could have come from parseCommand, with a name
+   among the trace's names, a positive size and a strategy it accepts */
+bool validRecord(struct traceRecord *r, long names) {
+
+    if (r->op > TRACE_LATENCY) {
+        return false;
+    }
+    if (r->op != TRACE_REQUEST && r->op != TRACE_RELEASE && r->op != TRACE_RESIZE) {
+        return true;
+    }
+    if (r->name >= names) {
+        return false;
+    }
+    if (r->op == TRACE_RELEASE) {
+        return true;
+    }
+
+    /* a resize may leave its strategy out, a request may not */
+    bool strategy = r->strategy != 0 ? strchr("FBWNT", r->strategy) != NULL : r->op == TRACE_RESIZE;
+    return r->size > 0 && strategy;
+}
+
+bool isBinaryTrace(FILE *in) {
+
+    char magic[8];
+    bool binary = fread(magic, 1, sizeof(magic), in) == sizeof(magic) &&
+                  memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+    rewind(in);
+    return binary;
+}
+
+/* runs one record against memory. Given a strategy, requests use it
+   instead of their own and STAT and STATS print nothing */
+void runRecord(struct traceRecord *r, char **names, char strategy) {
+
+    totals.commands++;
+
+    long begin = latencyClock();
+    if (r->op == TRACE_REQUEST) {
+        char flag = strategy ? strategy : r->strategy;
+        if (requestProcess(names[r->name], r->size, flag) < 0) {
+            totals.errors++;
+        }
+        recordLatency(timedRequest(flag), latencyClock() - begin);
+    } else if (r->op == TRACE_RELEASE) {
+        if (makeProcessHole(names[r->name]) < 0) {
+            totals.errors++;
+        }
+        recordLatency(TIMED_RELEASE, latencyClock() - begin);
+    } else if (r->op == TRACE_RESIZE) {
+        if (resizeNamed(names[r->name], r->size, strategy ? strategy : r->strategy) < 0) {
+            totals.errors++;
+        }
+        recordLatency(TIMED_RESIZE, latencyClock() - begin);
+    } else if (r->op == TRACE_COMPACT) {
+        compact();
+        recordLatency(TIMED_COMPACT, latencyClock() - begin);
+    } else if (strategy) {
+        /* several allocators are replaying side by side */
+    } else if (r->op == TRACE_STAT) {
+        stat();
+    } else if (r->op == TRACE_LATENCY) {
+        printLatency();
+    } else {
+        printStats();
+    }
+
+    takeSample();
+}
+
+void *runTraceJob(void *arg) {
+
+    struct traceJob *j = (struct traceJob *) arg;
+
+    worker = j->id;
+    useInstance(&j->memory);
+
+    long i;
+    for (i = 0; i < j->count; i++) {
+        runRecord(&j->records[j->mine[i]], j->names, 0);
+    }
+
+    j->totals = totals;
+    return NULL;
+}
+
+/* maps a binary trace and checks every section lies inside the file */
+int mapTrace(FILE *in, struct trace *t) {
+
+    fseek(in, 0, SEEK_END);
+    t->length = ftell(in);
+    rewind(in);
+
+    t->mapped = mmap(NULL, t->length, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+    if (t->mapped == MAP_FAILED) {
+        t->mapped = NULL;
+        printf("Could not map the trace.\n");
+        return -1;
+    }
+    madvise(t->mapped, t->length, MADV_SEQUENTIAL);
+
+    struct traceHeader *h = (struct traceHeader *) t->mapped;
+    char *at = (char *) t->mapped + sizeof(*h);
+    long left = t->length - sizeof(*h);
+
+    /* every section has to lie inside the file, the text last */
+    bool valid = t->length >= (long) sizeof(*h) && h->version == TRACE_VERSION && h->records >= 0 &&
+                 h->records <= left / (long) sizeof(struct traceRecord);
+    if (valid) {
+        left -= h->records * sizeof(struct traceRecord);
+        valid = h->names >= 0 && h->names <= left / (long) sizeof(long) &&
+                h->text == left - h->names * (long) sizeof(long) &&
+                (h->text == 0 || at[t->length - sizeof(*h) - 1] == '\0');
+    }
+    if (!valid) {
+        printf("The trace is damaged.\n");
+        return -1;
+    }
+
+    t->records = (struct traceRecord *) at;
+    t->count = h->records;
+    long *offsets = (long *) (at + h->records * sizeof(struct traceRecord));
+    char *text = (char *) (offsets + h->names);
+
+    /* names are used straight from the file */
+    t->names = (char **) malloc(sizeof(char *) * (h->names + 1));
+    t->nameCount = h->names;
+    long i;
+    for (i = 0; i < h->names; i++) {
+        if (offsets[i] < 0 || offsets[i] >= h->text) {
+            printf("The trace is damaged.\n");
+            return -1;
+        }
+        t->names[i] = text + offsets[i];
+    }
+    for (i = 0; i < h->records; i++) {
+        if (!validRecord(&t->records[i], h->names)) {
+            printf("The trace is damaged.\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* parses a text trace into records, dropping commands with none */
+void parseTrace(FILE *in, struct trace *t) {
+
+    long size = 1024;
+    t->records = (struct traceRecord *) malloc(sizeof(struct traceRecord) * size);
+
+    struct reader *lines = openReader(in);
+    char *line;
+    while ((line = readLine(lines))) {
+        struct command c;
+        splitCommand(line, &c);
+        if (isQuit(&c)) {
+            break;
+        }
+        if (parseCommand(&c, &t->records[t->count], &t->table, &t->capacity, &t->nameCount) <= 0) {
+            continue;
+        }
+        if (++t->count == size) {
+            size *= 2;
+            t->records = (struct traceRecord *) realloc(t->records, sizeof(struct traceRecord) * size);
+        }
+    }
+    closeReader(lines);
+
+    t->names = (char **) malloc(sizeof(char *) * (t->nameCount + 1));
+    long i;
+    for (i = 0; i < t->capacity; i++) {
+        if (t->table[i].str) {
+            t->names[t->table[i].id] = t->table[i].str;
+        }
+    }
+}
+
+struct trace *loadTrace(FILE *in) {
+
+    struct trace *t = (struct trace *) calloc(1, sizeof(struct trace));
+
+    if (!isBinaryTrace(in)) {
+        parseTrace(in, t);
+    } else if (mapTrace(in, t) < 0) {
+        freeTrace(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+long traceLength(struct trace *t) {
+
+    return t->count;
+}
+
+void replayTrace(struct trace *t, char strategy, double *peak) {
+
+    long i;
+    for (i = 0; i < t->count; i++) {
+        runRecord(&t->records[i], t->names, strategy);
+
+        if (peak) {
+            struct metrics m;
+            gatherMetrics(&m);
+            double fragmentation = externalFragmentation(&m);
+            if (fragmentation > *peak) {
+                *peak = fragmentation;
+            }
+        }
+    }
+}
+
+void freeTrace(struct trace *t) {
+
+    if (t->mapped) {
+        munmap(t->mapped, t->length);
+    } else {
+        free(t->records);
+    }
+
+    long i;
+    for (i = 0; i < t->capacity; i++) {
+        free(t->table[i].str);
+    }
+    free(t->table);
+    free(t->names);
+    free(t);
+}
+
+int replayBinary(FILE *in) {
+
+    struct trace *t = loadTrace(in);
+    if (!t) {
+        return -1;
+    }
+
+    long i;
+    if (workers == 1) {
+        replayTrace(t, 0, NULL);
+    } else {
+        /* every record for a name runs on one worker, in trace order.
+           Batches have no record, so no command spans workers */
+        struct traceJob *jobs = (struct traceJob *) calloc(workers, sizeof(struct traceJob));
+        pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * workers);
+        int *owner = (int *) malloc(sizeof(int) * (t->count + 1));
+
+        for (i = 0; i < t->count; i++) {
+            struct traceRecord *r = &t->records[i];
+            owner[i] = r->op == TRACE_REQUEST || r->op == TRACE_RELEASE || r->op == TRACE_RESIZE ?
+                       (int) (((unsigned long long) hashName(t->names[r->name]) * workers) >> 32) : 0;
+            jobs[owner[i]].count++;
+        }
+
+        int w;
+        for (w = 0; w < workers; w++) {
+            jobs[w].id = w;
+            jobs[w].records = t->records;
+            jobs[w].names = t->names;
+            jobs[w].mine = (long *) malloc(sizeof(long) * (jobs[w].count + 1));
+            jobs[w].count = 0;
+            saveInstance(&jobs[w].memory);
+        }
+        for (i = 0; i < t->count; i++) {
+            struct traceJob *j = &jobs[owner[i]];
+            j->mine[j->count++] = i;
+        }
+
+        for (w = 0; w < workers; w++) {
+            pthread_create(&threads[w], NULL, runTraceJob, &jobs[w]);
+        }
+        for (w = 0; w < workers; w++) {
+            pthread_join(threads[w], NULL);
+            addTotals(&totals, &jobs[w].totals);
+            free(jobs[w].mine);
+        }
+
+        free(owner);
+        free(threads);
+        free(jobs);
+    }
+
+    freeTrace(t);
+    return 0;
+}